@@ -0,0 +1,286 @@
+// Copyright 2024 viktorlanner
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Microbenchmarks of the peasyocl host paths. Runs on the default OpenCL
+// device, e.g. POCL's CPU device, and writes the results as JSON:
+//
+//     peasyocl_bench [output.json] [iterations]
+//
+// Set POCL_KERNEL_CACHE=0 with POCL so cold builds are not served from its
+// on-disk cache.
+
+#include "Context.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace peasyocl;
+
+namespace {
+
+const char *BenchSource = R"(
+__kernel void bench_empty(__global float *data, int value) {}
+)";
+
+// Trilinear sampling of a size^3 grid at points in [0, 1], by hand from a
+// buffer and through a linear filtering sampler from an image
+const char *SampleSource = R"(
+__kernel void sample_buffer(__global const float *grid, int size,
+                            __global const float4 *points,
+                            __global float *out) {
+    int i = get_global_id(0);
+    float3 p = points[i].xyz * (float)(size - 1);
+    int3 p0 = clamp(convert_int3(floor(p)), 0, size - 2);
+    float3 f = p - convert_float3(p0);
+    int row = size, slice = size * size;
+    int base = p0.z * slice + p0.y * row + p0.x;
+    float c00 = mix(grid[base], grid[base + 1], f.x);
+    float c10 = mix(grid[base + row], grid[base + row + 1], f.x);
+    float c01 = mix(grid[base + slice], grid[base + slice + 1], f.x);
+    float c11 = mix(grid[base + slice + row], grid[base + slice + row + 1],
+                    f.x);
+    out[i] = mix(mix(c00, c10, f.y), mix(c01, c11, f.y), f.z);
+}
+
+__kernel void sample_image(__read_only image3d_t grid, sampler_t sampler,
+                           __global const float4 *points,
+                           __global float *out) {
+    int i = get_global_id(0);
+    float size = (float)get_image_width(grid);
+    float3 p = (points[i].xyz * (size - 1.0f) + 0.5f) / size;
+    out[i] = read_imagef(grid, sampler, (float4)(p, 0.0f)).x;
+}
+)";
+
+struct Result {
+    std::string name;
+    size_t bytes = 0;
+    size_t iterations = 0;
+    double mean = 0.0;
+    double median = 0.0;
+    double min = 0.0;
+    double p95 = 0.0;
+};
+
+uint64_t Now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+/**
+ * @brief Time iterations calls of run after a few warm up calls. Timings are
+ * in nanoseconds
+ *
+ */
+template <typename Run>
+Result Measure(const std::string &name, const size_t &iterations, Run run,
+               const size_t &bytes = 0) {
+    for (size_t i = 0; i < std::min<size_t>(iterations, 8); i++) {
+        run(i);
+    }
+
+    std::vector<double> samples(iterations);
+    for (size_t i = 0; i < iterations; i++) {
+        uint64_t start = Now();
+        run(i);
+        samples[i] = double(Now() - start);
+    }
+    std::sort(samples.begin(), samples.end());
+
+    Result result;
+    result.name = name;
+    result.bytes = bytes;
+    result.iterations = iterations;
+    for (double sample : samples) {
+        result.mean += sample;
+    }
+    result.mean /= samples.size();
+    result.median = samples[samples.size() / 2];
+    result.min = samples.front();
+    result.p95 = samples[std::min(samples.size() - 1,
+                                  size_t(samples.size() * 0.95))];
+    return result;
+}
+
+int WriteJson(const std::string &path, const std::string &device,
+              const std::vector<Result> &results) {
+    FILE *file = fopen(path.c_str(), "w");
+    if (!file) {
+        printf("Error: Failed to open %s!\n", path.c_str());
+        return 1;
+    }
+
+    fprintf(file, "{\n  \"device\": \"%s\",\n  \"results\": [\n",
+            device.c_str());
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result &r = results[i];
+        // Bytes per nanosecond is GB/s
+        double bandwidth = r.bytes > 0 ? r.bytes / r.median : 0.0;
+        fprintf(file,
+                "    {\"name\": \"%s\", \"bytes\": %zu, \"iterations\": %zu, "
+                "\"mean_ns\": %.1f, \"median_ns\": %.1f, \"min_ns\": %.1f, "
+                "\"p95_ns\": %.1f, \"gbps\": %.3f}%s\n",
+                r.name.c_str(), r.bytes, r.iterations, r.mean, r.median, r.min,
+                r.p95, bandwidth, i + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    fclose(file);
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    std::string output = argc > 1 ? argv[1] : "peasyocl_bench.json";
+    size_t iterations = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 1000;
+    if (iterations == 0) {
+        iterations = 1;
+    }
+
+    Context *ctx = Context::GetInstance();
+    if (ctx->Init() != 0) {
+        return 1;
+    }
+
+    std::string device;
+    cl::Device::getDefault().getInfo(CL_DEVICE_NAME, &device);
+    device.erase(std::remove(device.begin(), device.end(), '"'), device.end());
+    printf("Benchmarking on %s\n", device.c_str());
+
+    std::vector<Result> results;
+
+    // Cold builds use a new source each time, warm builds hit the program
+    // cache with the same source under a new key
+    size_t builds = std::max<size_t>(iterations / 100, 4);
+    size_t cold = 0, warm = 0;
+    results.push_back(Measure("AddKernel cold", builds, [&](size_t) {
+        std::string code = std::string(BenchSource) + "// variant " +
+                           std::to_string(cold) + "\n";
+        ctx->AddKernel(code, {}, "bench_empty",
+                       "bench_cold_" + std::to_string(cold++));
+    }));
+    results.push_back(Measure("AddKernel warm", builds, [&](size_t) {
+        ctx->AddKernel(BenchSource, {}, "bench_empty",
+                       "bench_warm_" + std::to_string(warm++));
+    }));
+
+    const size_t maxBytes = size_t(64) << 20;
+    KernelHandle *kernel =
+        ctx->AddKernel(BenchSource, {}, "bench_empty", "bench_empty");
+    if (!kernel) {
+        return 1;
+    }
+    int err = !kernel->AddArgument<float>(CL_MEM_READ_WRITE, "bench_data",
+                                          maxBytes, nullptr);
+    err |= !kernel->AddArgument<int>(CL_MEM_READ_ONLY, "bench_value", 1, false);
+    err |= kernel->SetArgument<int>("bench_value", 0);
+    if (err != 0) {
+        return 1;
+    }
+
+    results.push_back(Measure("Execute empty", iterations, [&](size_t) {
+        ctx->Execute(1, kernel);
+    }));
+    results.push_back(Measure("SetArgument", iterations, [&](size_t i) {
+        kernel->SetArgument<int>("bench_value", int(i));
+    }));
+
+    std::vector<float> host(maxBytes / sizeof(float), 1.0f);
+    for (size_t bytes = size_t(4) << 10; bytes <= maxBytes; bytes <<= 2) {
+        // Keep the total moved per size roughly constant
+        size_t count = std::min(
+            std::max<size_t>((size_t(256) << 20) / bytes, 8), iterations);
+        results.push_back(Measure(
+            "SetBufferData", count,
+            [&](size_t) {
+                kernel->SetBufferData(host.data(), "bench_data", bytes);
+            },
+            bytes));
+        results.push_back(Measure(
+            "ReadBufferData", count,
+            [&](size_t) {
+                kernel->ReadBufferData(host.data(), "bench_data", bytes);
+            },
+            bytes));
+    }
+
+    cl_bool images = CL_FALSE;
+    cl::Device::getDefault().getInfo(CL_DEVICE_IMAGE_SUPPORT, &images);
+    if (images) {
+        const int gridSize = 128;
+        const size_t points = size_t(1) << 20;
+        const size_t gridBytes = size_t(gridSize) * gridSize * gridSize *
+                                 sizeof(float);
+        std::vector<float> grid(gridBytes / sizeof(float));
+        for (size_t i = 0; i < grid.size(); i++) {
+            grid[i] = float(i % 251) / 251.0f;
+        }
+        std::vector<cl_float4> coords(points);
+        for (size_t i = 0; i < points; i++) {
+            coords[i] = {{float(i % 97) / 97.0f, float(i % 89) / 89.0f,
+                          float(i % 83) / 83.0f, 0.0f}};
+        }
+
+        KernelHandle *buffer =
+            ctx->AddKernel(SampleSource, {}, "sample_buffer", "sample_buffer");
+        KernelHandle *image =
+            ctx->AddKernel(SampleSource, {}, "sample_image", "sample_image");
+        if (!buffer || !image) {
+            return 1;
+        }
+        err = !buffer->AddArgument<float>(CL_MEM_READ_ONLY, "sample_grid",
+                                          gridBytes, grid.data());
+        err |= !buffer->AddArgument<int>(CL_MEM_READ_ONLY, "sample_size", 1,
+                                         false);
+        err |= buffer->SetArgument<int>("sample_size", gridSize);
+        err |= !buffer->AddArgument<cl_float4>(CL_MEM_READ_ONLY,
+                                               "sample_points",
+                                               points * sizeof(cl_float4),
+                                               coords.data());
+        err |= !buffer->AddArgument<float>(CL_MEM_WRITE_ONLY, "sample_out",
+                                           points * sizeof(float));
+        err |= !image->AddImage3DArgument(
+            CL_MEM_READ_ONLY, "sample_volume", cl::ImageFormat(CL_R, CL_FLOAT),
+            gridSize, gridSize, gridSize, grid.data());
+        err |= !image->AddSamplerArgument("sample_linear");
+        err |= !image->AddArgument<cl_float4>(CL_MEM_READ_ONLY,
+                                              "sample_points",
+                                              points * sizeof(cl_float4));
+        err |= !image->AddArgument<float>(CL_MEM_WRITE_ONLY, "sample_out",
+                                          points * sizeof(float));
+        if (err != 0) {
+            return 1;
+        }
+
+        size_t count = std::min<size_t>(iterations, 100);
+        results.push_back(Measure("Sample buffer", count, [&](size_t) {
+            ctx->Execute(points, buffer);
+        }));
+        results.push_back(Measure("Sample image", count, [&](size_t) {
+            ctx->Execute(points, image);
+        }));
+    }
+
+    for (const Result &r : results) {
+        printf("%-16s %10zu B %12.0f ns median\n", r.name.c_str(), r.bytes,
+               r.median);
+    }
+    return WriteJson(output, device, results);
+}
@@ -16,36 +16,112 @@
 
 #include "KernelUtils.h"
 
+#include <chrono>
+
 namespace peasyocl {
 
+/**
+ * @brief Merge spans that continue each other both in host memory and in the
+ * buffer, so they can be transferred with a single command
+ *
+ */
+template <typename Pointer>
+static std::vector<HostSpan<Pointer>>
+MergeSpans(const std::vector<HostSpan<Pointer>> &spans) {
+    std::vector<HostSpan<Pointer>> merged;
+    merged.reserve(spans.size());
+    for (const HostSpan<Pointer> &span : spans) {
+        if (span.size == 0) {
+            continue;
+        }
+        if (!merged.empty()) {
+            HostSpan<Pointer> &last = merged.back();
+            const char *end = static_cast<const char *>(last.data) + last.size;
+            if (end == static_cast<const char *>(span.data) &&
+                last.offset + last.size == span.offset) {
+                last.size += span.size;
+                continue;
+            }
+        }
+        merged.push_back(span);
+    }
+    return merged;
+}
+
+Context::~Context() {
+    if (initialized) {
+        _queue.finish();
+    }
+    // Run the remaining callbacks while the profiler and trace still exist
+    _dispatcher.Stop();
+}
+
 int Context::Init() {
     if (initialized) {
         return 0;
     }
 
     cl_int err;
-    _device = cl::Device::getDefault(&err);
+    cl::Device device = cl::Device::getDefault(&err);
     if (err != CL_SUCCESS) {
         printf("Error: Failed to create a device group! %i \n", err);
         return 1;
     }
+    return Init(device);
+}
+
+int Context::Init(const cl::Device &device) {
+    if (initialized) {
+        return 0;
+    }
 
+    cl_int err;
+    _device = device;
     _context = cl::Context(_device, nullptr, nullptr, nullptr, &err);
     if (err != CL_SUCCESS) {
         printf("Error: Failed to create a device group! %i \n", err);
         return 1;
     }
 
-    _queue = cl::CommandQueue(_context, _device, 0, &err);
+    cl_command_queue_properties properties =
+        _profiling ? CL_QUEUE_PROFILING_ENABLE : 0;
+    _queue = cl::CommandQueue(_context, _device, properties, &err);
     if (err != CL_SUCCESS) {
         printf("Error: Failed to create a command commands! %i \n", err);
         return 1;
     }
+
+    if (_memory.Init(&_context, &_queue, _device) != 0) {
+        return 1;
+    }
     initialized = true;
 
     return 0;
 }
 
+int Context::SetProfiling(const bool enabled) {
+    if (enabled == _profiling) {
+        return 0;
+    }
+    _profiling = enabled;
+    if (!initialized) {
+        return 0;
+    }
+
+    // Kernel handles point at _queue, so it is replaced in place
+    std::lock_guard<std::mutex> submit(_submitMutex);
+    _queue.finish();
+    cl_int err;
+    cl_command_queue_properties properties =
+        _profiling ? CL_QUEUE_PROFILING_ENABLE : 0;
+    _queue = cl::CommandQueue(_context, _device, properties, &err);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to create a command commands! %i \n", err);
+        return 1;
+    }
+    return 0;
+}
+
 // int Context::AddSource(const utils::ClFile &clfile) {
 //     std::string kernelSource = clfile.LoadClKernelSource();
 //     return AddSource(kernelSource);
@@ -94,22 +170,446 @@ int Context::Init() {
 //     return 0;
 // }
 
+SharedBuffer Context::CreateBuffer(const std::string &name,
+                                  cl_mem_flags flags, const size_t &size) {
+    _memory.Reserve(size);
+
+    cl_int err;
+    SharedBuffer buffer =
+        std::make_shared<cl::Buffer>(_context, flags, size, nullptr, &err);
+    if (err == CL_MEM_OBJECT_ALLOCATION_FAILURE && _memory.EvictUnused() > 0) {
+        *buffer = cl::Buffer(_context, flags, size, nullptr, &err);
+    }
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to create buffer %s! %i\n", name.c_str(), err);
+        return nullptr;
+    }
+
+    AddBuffer(name, buffer, size);
+    return buffer;
+}
+
 void Context::AddBuffer(const std::string &name, SharedBuffer buffer, const size_t &size) {
-    _buffers.insert({name, {std::move(buffer), size}});    
+    auto [entry, inserted] =
+        _buffers.TryEmplace(name, [&](BufferEntry &entry) {
+            entry.name = name;
+            entry.buffer = std::move(buffer);
+            entry.size = size;
+            entry.buffer->getInfo(CL_MEM_FLAGS, &entry.flags);
+            _memory.Track(entry);
+        });
+    if (!inserted) {
+        return;
+    }
+    _bufferLookup.InsertOrAssign(entry->buffer.get(), entry);
 }
 
 SharedBuffer Context::GetBuffer(const std::string &name) {
-    if (_buffers.count(name) == 0) {
+    BufferEntry *entry = GetBufferEntry(name);
+    if (!entry) {
+        return nullptr;
+    }
+    _memory.Touch(*entry);
+    return entry->buffer;
+}
+
+SharedImage Context::CreateImage2D(const std::string &name,
+                                  cl_mem_flags flags,
+                                  const cl::ImageFormat &format,
+                                  const size_t &width, const size_t &height) {
+    return CreateImage3D(name, flags, format, width, height, 0);
+}
+
+SharedImage Context::CreateImage3D(const std::string &name,
+                                  cl_mem_flags flags,
+                                  const cl::ImageFormat &format,
+                                  const size_t &width, const size_t &height,
+                                  const size_t &depth) {
+    if (_images.Contains(name)) {
+        printf("Error: Image %s already exists!\n", name.c_str());
         return nullptr;
     }
-    return _buffers.at(name).first;
+    size_t pixelSize = utils::PixelSize(format);
+    if (pixelSize == 0) {
+        printf("Error: Unsupported format for image %s!\n", name.c_str());
+        return nullptr;
+    }
+    size_t size = width * height * (depth > 0 ? depth : 1) * pixelSize;
+    _memory.Reserve(size);
+
+    cl_int err;
+    auto create = [&]() -> SharedImage {
+        if (depth > 0) {
+            return std::make_shared<cl::Image3D>(_context, flags, format, width,
+                                                 height, depth, 0, 0, nullptr,
+                                                 &err);
+        }
+        return std::make_shared<cl::Image2D>(_context, flags, format, width,
+                                             height, 0, nullptr, &err);
+    };
+    SharedImage image = create();
+    if (err == CL_MEM_OBJECT_ALLOCATION_FAILURE && _memory.EvictUnused() > 0) {
+        image = create();
+    }
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to create image %s! %i\n", name.c_str(), err);
+        return nullptr;
+    }
+
+    if (!_images.TryEmplace(name, [&](ImageEntry &entry) {
+             entry.name = name;
+             entry.image = image;
+             entry.format = format;
+             entry.flags = flags;
+             entry.width = width;
+             entry.height = height;
+             entry.depth = depth > 0 ? depth : 1;
+             entry.pixelSize = pixelSize;
+             entry.is3D = depth > 0;
+             _memory.TrackFixed(size);
+         }).second) {
+        printf("Error: Image %s already exists!\n", name.c_str());
+        return nullptr;
+    }
+    return image;
+}
+
+SharedImage Context::GetImage(const std::string &name) {
+    ImageEntry *entry = GetImageEntry(name);
+    return entry ? entry->image : nullptr;
+}
+
+ImageEntry *Context::GetImageEntry(const std::string &name) {
+    return _images.Find(name);
+}
+
+int Context::WriteImage(const std::string &name, const void *data,
+                        const size_t &rowPitch, const size_t &slicePitch) {
+    ImageEntry *entry = GetImageEntry(name);
+    if (!entry) {
+        printf("Error: Image %s is not recognized!\n", name.c_str());
+        return 1;
+    }
+    TraceScope trace(_trace, "transfer", "WriteImage");
+    cl::Event ev;
+    cl_int err = _queue.enqueueWriteImage(
+        *entry->image, CL_TRUE, {0, 0, 0}, entry->Region(), rowPitch,
+        slicePitch, const_cast<void *>(data), nullptr,
+        _profiling ? &ev : nullptr);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to write image %s! %i\n", name.c_str(), err);
+        return 1;
+    }
+    ProfileTransfer(name, ev, TransferDirection::Upload, entry->Size());
+    return 0;
+}
+
+int Context::ReadImage(const std::string &name, void *data,
+                       const size_t &rowPitch, const size_t &slicePitch) {
+    ImageEntry *entry = GetImageEntry(name);
+    if (!entry) {
+        printf("Error: Image %s is not recognized!\n", name.c_str());
+        return 1;
+    }
+    TraceScope trace(_trace, "transfer", "ReadImage");
+    cl::Event ev;
+    cl_int err = _queue.enqueueReadImage(*entry->image, CL_TRUE, {0, 0, 0},
+                                         entry->Region(), rowPitch, slicePitch,
+                                         data, nullptr,
+                                         _profiling ? &ev : nullptr);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to read image %s! %i\n", name.c_str(), err);
+        return 1;
+    }
+    ProfileTransfer(name, ev, TransferDirection::Download, entry->Size());
+    return 0;
+}
+
+cl::Sampler *Context::CreateSampler(const std::string &name,
+                                    const cl_bool &normalized,
+                                    const cl_addressing_mode &addressing,
+                                    const cl_filter_mode &filter) {
+    if (cl::Sampler *found = _samplers.Find(name)) {
+        return found;
+    }
+    cl_int err;
+    cl::Sampler sampler(_context, normalized, addressing, filter, &err);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to create sampler %s! %i\n", name.c_str(), err);
+        return nullptr;
+    }
+    // Another thread may have created it in the meantime
+    return _samplers
+        .TryEmplace(name,
+                    [&](cl::Sampler &stored) { stored = std::move(sampler); })
+        .first;
+}
+
+cl::Sampler *Context::GetSampler(const std::string &name) {
+    return _samplers.Find(name);
+}
+
+int KernelHandle::BindIndex(const std::string &name, const bool buffer,
+                            const cl_mem_flags &flags) const {
+    if (argInfo.empty()) {
+        return argCount;
+    }
+
+    for (size_t i = 0; i < argInfo.size(); i++) {
+        const KernelArgInfo &arg = argInfo[i];
+        if (arg.name != name) {
+            continue;
+        }
+        if (buffer != arg.IsBuffer()) {
+            printf("Error: Argument %s of kernel %s is a %s %s, not a %s!\n",
+                   name.c_str(), key.c_str(),
+                   arg.IsBuffer() ? "buffer" : "value", arg.typeName.c_str(),
+                   buffer ? "buffer" : "value");
+            return -1;
+        }
+        if (buffer && arg.IsReadOnly() && (flags & CL_MEM_WRITE_ONLY)) {
+            printf("Error: Argument %s of kernel %s is read only, but its "
+                   "buffer is CL_MEM_WRITE_ONLY!\n",
+                   name.c_str(), key.c_str());
+            return -1;
+        }
+        return static_cast<int>(i);
+    }
+
+    printf("Error: Kernel %s has no argument called %s!\n", key.c_str(),
+           name.c_str());
+    return -1;
+}
+
+cl_int KernelHandle::BindArgument(const int index, const size_t &size,
+                                  const void *value) {
+    PEASYOCL_HOST_STAGE(owner->GetHostCounters(), SetArgument);
+    return utils::BindShadowed(kernel, shadow, index, size, value,
+                               &elidedCalls);
+}
+
+ArgStatus KernelHandle::AddImageArgument(const std::string &name) {
+    ImageEntry *entry = owner->GetImageEntry(name);
+    if (!entry) {
+        printf("Error: Image %s is not recognized!\n", name.c_str());
+        return {};
+    }
+    int index = BindIndex(name, true, entry->flags);
+    if (index < 0) {
+        return {};
+    }
+    const KernelArgInfo *info = GetArgumentInfo(name);
+    if (info && info->typeName.rfind("image", 0) != 0) {
+        printf("Error: Argument %s of kernel %s is not an image!\n",
+               name.c_str(), key.c_str());
+        return {};
+    }
+
+    dirty = true;
+    cl_int err = BindArgument(index, sizeof(cl_mem), &(*entry->image)());
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to set image %s! %i\n", name.c_str(), err);
+        return {};
+    }
+    entry->users++;
+    images.push_back(entry);
+    arguments.insert({name, index});
+    argCount++;
+    return {index, 0};
+}
+
+ArgStatus KernelHandle::AddImage2DArgument(cl_mem_flags flags,
+                                           const std::string &name,
+                                           const cl::ImageFormat &format,
+                                           const size_t &width,
+                                           const size_t &height,
+                                           const void *data) {
+    return AddImage3DArgument(flags, name, format, width, height, 0, data);
+}
+
+ArgStatus KernelHandle::AddImage3DArgument(cl_mem_flags flags,
+                                           const std::string &name,
+                                           const cl::ImageFormat &format,
+                                           const size_t &width,
+                                           const size_t &height,
+                                           const size_t &depth,
+                                           const void *data) {
+    // An existing image is reused, so data must have its format and extent
+    ImageEntry *existing = owner->GetImageEntry(name);
+    if (existing && !existing->Matches(format, width, height, depth)) {
+        printf("Error: Image %s already exists with a different format or "
+               "size!\n",
+               name.c_str());
+        return {};
+    }
+    if (!existing &&
+        !owner->CreateImage3D(name, flags, format, width, height, depth)) {
+        return {};
+    }
+    if (data != nullptr && owner->WriteImage(name, data) != 0) {
+        return {};
+    }
+    return AddImageArgument(name);
+}
+
+ArgStatus KernelHandle::AddSamplerArgument(const std::string &name,
+                                           const cl_bool &normalized,
+                                           const cl_addressing_mode &addressing,
+                                           const cl_filter_mode &filter) {
+    cl::Sampler *sampler = owner->CreateSampler(
+        name, normalized, addressing, filter);
+    if (!sampler) {
+        return {};
+    }
+    int index = BindIndex(name, false);
+    if (index < 0) {
+        return {};
+    }
+    const KernelArgInfo *info = GetArgumentInfo(name);
+    if (info && info->typeName != "sampler_t") {
+        printf("Error: Argument %s of kernel %s is not a sampler!\n",
+               name.c_str(), key.c_str());
+        return {};
+    }
+
+    dirty = true;
+    cl_int err = BindArgument(index, sizeof(cl_sampler), &(*sampler)());
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to set sampler %s! %i\n", name.c_str(), err);
+        return {};
+    }
+    arguments.insert({name, index});
+    argCount++;
+    return {index, 0};
+}
+
+int KernelHandle::SetImageData(const void *data, const std::string &name) {
+    if (arguments.find(name) == arguments.end()) {
+        printf("Error: Image %s is not recognized!\n", name.c_str());
+        return 1;
+    }
+    dirty = true;
+    return owner->WriteImage(name, data);
+}
+
+int KernelHandle::ReadImageData(void *data, const std::string &name) {
+    if (arguments.find(name) == arguments.end()) {
+        printf("Error: Image %s is not recognized!\n", name.c_str());
+        return 1;
+    }
+    return owner->ReadImage(name, data);
+}
+
+ArgStatus KernelHandle::AddLocalArgument(const std::string &name,
+                                         const size_t &size) {
+    return AddLocalArgument(name, [size](const size_t &) { return size; });
+}
+
+ArgStatus KernelHandle::AddLocalArgument(const std::string &name,
+                                         LocalSizer sizer) {
+    int index = BindIndex(name, false);
+    if (index < 0) {
+        return {};
+    }
+    const KernelArgInfo *info = GetArgumentInfo(name);
+    if (info && !info->IsLocal()) {
+        printf("Error: Argument %s of kernel %s is not __local!\n",
+               name.c_str(), key.c_str());
+        return {};
+    }
+
+    dirty = true;
+    locals.push_back({index, 0, std::move(sizer)});
+    arguments.insert({name, index});
+    argCount++;
+    // Size the new argument at the next launch
+    localSize = 0;
+    return {index, 0};
+}
+
+int KernelHandle::SizeLocalArguments(const size_t &size) {
+    if (size == localSize) {
+        return 0;
+    }
+    for (LocalArgument &local : locals) {
+        local.size = local.sizer(size);
+        cl_int err = BindArgument(local.index, local.size, nullptr);
+        if (err != CL_SUCCESS) {
+            printf("Error: Failed to set %zu bytes of local memory for "
+                   "kernel %s! %i\n",
+                   local.size, key.c_str(), err);
+            return 1;
+        }
+    }
+    localSize = size;
+    // CL_KERNEL_LOCAL_MEM_SIZE includes the __local arguments just bound
+    return utils::QueryKernelLocalMemory(kernel, owner->GetDevice(),
+                                         &resources);
+}
+
+const KernelArgInfo *
+KernelHandle::GetArgumentInfo(const std::string &name) const {
+    for (const KernelArgInfo &arg : argInfo) {
+        if (arg.name == name) {
+            return &arg;
+        }
+    }
+    return nullptr;
+}
+
+SharedBuffer Context::GetBuffer(BufferEntry *entry) {
+    if (!entry) {
+        return nullptr;
+    }
+    _memory.Touch(*entry);
+    return entry->buffer;
+}
+
+BufferEntry *Context::GetBufferEntry(const std::string &name) {
+    PEASYOCL_HOST_STAGE(_hostCounters, BufferLookup);
+    return _buffers.Find(name);
+}
+
+BufferEntry *Context::GetBufferEntry(const SharedBuffer &buffer) {
+    BufferEntry **found = _bufferLookup.Find(buffer.get());
+    return found ? *found : nullptr;
+}
+
+BufferPin Context::PinBuffer(const SharedBuffer &buffer) {
+    return BufferPin(&_memory, buffer ? GetBufferEntry(buffer) : nullptr,
+                     buffer);
 }
 
 const size_t Context::GetBufferSize(const std::string &name) {
-    if (_buffers.count(name) == 0) {
+    BufferEntry *entry = _buffers.Find(name);
+    if (!entry) {
         return {};
     }
-    return _buffers.at(name).second;
+    return entry->size;
+}
+
+SharedMirror Context::AddMirror(const std::string &name,
+                                const size_t &pageSize) {
+    BufferEntry *entry = _buffers.Find(name);
+    if (!entry) {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(_mirrorMutex);
+    if (!entry->mirror) {
+        entry->mirror =
+            std::make_shared<HostMirror>(entry->buffer, entry->size, pageSize);
+    }
+    return entry->mirror;
+}
+
+SharedMirror Context::GetMirror(const std::string &name) {
+    BufferEntry *entry = _buffers.Find(name);
+    if (!entry) {
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(_mirrorMutex);
+    return entry->mirror;
 }
 
 KernelHandle *Context::AddKernel(const std::string &code,
@@ -125,35 +625,60 @@ KernelHandle *Context::AddKernel(const std::string &code,
         handle.key = kernelName;
     }
 
-    if (auto foundKernel = _kernels.find(handle.key); foundKernel != _kernels.end()) {
-        if (foundKernel->second.built) {
-            return &foundKernel->second;
+    if (KernelHandle *found = _kernels.Find(handle.key)) {
+        if (found->built) {
+            return found;
         }
     }
 
-    int err;
-    handle.program = cl::Program(_context, code.c_str(), false, &err);
-
-    if (err != CL_SUCCESS) {
-        handle.built = false;
-        printf("Error: Failed to create compute program! %i \n", err);
-        return nullptr;
-    }
-
-    std::string flags = "-cl-std=CL1.2 ";
+    TraceScope trace(_trace, "build", handle.key);
+    std::string flags = "-cl-std=CL1.2";
     for (utils::ClFile clFile : utils::ClFile::GetKernelPaths()) {
-        flags.append(std::string("-I ").append(clFile.path));
+        flags.append(" -I ").append(clFile.path);
     }
     for (std::string path : includes) {
-        flags.append(std::string("-I ").append(path));
+        flags.append(" -I ").append(path);
+    }
+    if (_argumentInfo) {
+        flags.append(" -cl-kernel-arg-info");
     }
-    err = handle.program.build(_device, flags.c_str(), nullptr);
 
-    if (err != CL_SUCCESS) {
-        handle.built = false;
-        printf("Error: Failed to build program %s\n",
-               kernelName.c_str());
-        return nullptr;
+    BuildRecord record;
+    record.key = handle.key;
+    record.kernelName = kernelName;
+    record.flags = flags;
+    record.sourceSize = code.size();
+
+    int err;
+    auto start = std::chrono::steady_clock::now();
+    if (_programs.Find(code, flags, &handle.program, &record.log)) {
+        record.cacheHit = true;
+        record.time = std::chrono::duration<double, std::nano>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+    } else {
+        handle.program = cl::Program(_context, code.c_str(), false, &err);
+        if (err != CL_SUCCESS) {
+            handle.built = false;
+            printf("Error: Failed to create compute program! %i \n", err);
+            _programs.Record(std::move(record));
+            return nullptr;
+        }
+
+        err = handle.program.build(_device, flags.c_str(), nullptr);
+        handle.program.getBuildInfo(_device, CL_PROGRAM_BUILD_LOG,
+                                    &record.log);
+        record.time = std::chrono::duration<double, std::nano>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+        if (err != CL_SUCCESS) {
+            handle.built = false;
+            printf("Error: Failed to build program %s\n%s\n",
+                   kernelName.c_str(), record.log.c_str());
+            _programs.Record(std::move(record));
+            return nullptr;
+        }
+        _programs.Insert(code, flags, handle.program, record.log);
     }
 
     handle.kernel = cl::Kernel(handle.program, kernelName.c_str(), &err);
@@ -162,64 +687,244 @@ KernelHandle *Context::AddKernel(const std::string &code,
         handle.built = false;
         printf("Error: Failed to create compute kernel with name %s\n",
                kernelName.c_str());
+        _programs.Record(std::move(record));
+        return nullptr;
+    }
+
+    {
+        PEASYOCL_HOST_STAGE(_hostCounters, WorkGroupInfo);
+        err = utils::QueryKernelResources(handle.kernel, _device,
+                                          &handle.resources);
+    }
+    if (err == 0 && _argumentInfo) {
+        err = utils::QueryKernelArgs(handle.kernel, &handle.argInfo);
+    }
+    if (err != 0) {
+        handle.built = false;
+        _programs.Record(std::move(record));
         return nullptr;
     }
 
-    handle.built = true;
-    handle.context = &_context;
-    handle.queue = &_queue;
-    _kernels[handle.key] = handle;
-    return &_kernels[handle.key];
+    record.success = true;
+    _programs.Record(std::move(record));
+
+    // Another thread may have added the same key while this one was
+    // building. Its handle can already be in use, so keep it
+    return _kernels
+        .TryEmplace(handle.key,
+                    [&](KernelHandle &stored) {
+                        stored.key = handle.key;
+                        stored.kernelName = kernelName;
+                        stored.program = std::move(handle.program);
+                        stored.kernel = std::move(handle.kernel);
+                        stored.resources = handle.resources;
+                        stored.argInfo = std::move(handle.argInfo);
+                        stored.pool = std::make_shared<KernelPool>(
+                            stored.program, kernelName);
+                        stored.owner = this;
+                        stored.context = &_context;
+                        stored.queue = &_queue;
+                        stored.argumentMutex = std::make_shared<std::mutex>();
+                        stored.built = true;
+                    })
+        .first;
 }
 
 void Context::RemoveKernel(KernelHandle *kernel) {
-    KernelMap::iterator it = _kernels.find(kernel->key);
-    if (it == _kernels.end()) {
+    // Copied as erasing destroys the strings the keys refer to
+    std::string key = kernel->key;
+    if (!_kernels.Contains(key)) {
         return;
     }
-    long idx = std::distance(_kernels.begin(), it);
 
-    _kernels.erase(it);
+    // Free the buffers that no other kernel is bound to
+    for (BufferBinding &binding : kernel->bindings) {
+        BufferEntry *entry = binding.entry;
+        if (--entry->users > 0) {
+            continue;
+        }
+        _memory.Release(*entry);
+        _bufferLookup.Erase(entry->buffer.get());
+        std::string name = entry->name;
+        _buffers.Erase(name);
+    }
+    for (ImageEntry *entry : kernel->images) {
+        if (--entry->users > 0) {
+            continue;
+        }
+        _memory.ReleaseFixed(entry->Size());
+        std::string name = entry->name;
+        _images.Erase(name);
+    }
+
     kernel->built = false;
+    _kernels.Erase(key);
 }
 
 KernelHandle *Context::GetKernelHandle(const std::string &name) {
-    if (_kernels.find(name) == _kernels.end()) {
-        return nullptr;
-    }
-    return &_kernels[name];
+    PEASYOCL_HOST_STAGE(_hostCounters, KernelLookup);
+    return _kernels.Find(name);
 }
 
 int Context::Execute(const size_t &global, const std::string &kernelName) {
+    return Execute(global, 0, kernelName);
+}
+
+int Context::Execute(const size_t &global, KernelHandle *kernelHandle) {
+    return Execute(global, 0, kernelHandle);
+}
+
+int Context::Execute(const size_t &global, const size_t &local,
+                     const std::string &kernelName) {
     KernelHandle *kernel = GetKernelHandle(kernelName);
     if (!kernel) {
         return 1;
     }
-    return Execute(global, &_kernels[kernelName]);
+    return Execute(global, local, kernel);
 }
 
-int Context::Execute(const size_t &global, KernelHandle *kernelHandle) {
+int Context::Execute(const size_t &global, const size_t &local,
+                     KernelHandle *kernelHandle) {
     if (!initialized) {
         return 1;
     }
     if (!kernelHandle->built) {
         return 1;
     }
+    TraceScope trace(_trace, "kernel", kernelHandle->key);
+    PEASYOCL_HOST_STAGE(_hostCounters, Execute);
 
-    size_t local;
-    cl_int err;
-    err = kernelHandle->kernel.getWorkGroupInfo<size_t>(
-        _device, CL_KERNEL_WORK_GROUP_SIZE, &local);
-    if (err != CL_SUCCESS) {
-        printf("Error: Failed to retrieve kernel work group info! %d\n", err);
+    // Launch through the calling thread's kernel object, so launches of one
+    // handle from several threads do not share setArg state
+    KernelInstance *instance = kernelHandle->ThreadKernel();
+    if (!instance) {
         return 1;
     }
 
+    // Buffers pinned by this launch are not evicted until it is enqueued
+    std::vector<BufferEntry *> pinned;
+    auto unpin = [&]() {
+        for (BufferEntry *entry : pinned) {
+            _memory.Unpin(*entry);
+        }
+    };
+
+    _memory.BeginUse();
+    {
+        // The handle's arguments are only locked while they are brought up
+        // to date and copied to the instance
+        std::lock_guard<std::mutex> arguments(*kernelHandle->argumentMutex);
+
+        // Any work group size the implementation picks is at most the
+        // kernel's maximum, so sizing for that is always enough
+        if (!kernelHandle->locals.empty() &&
+            kernelHandle->SizeLocalArguments(
+                local > 0 ? local : kernelHandle->resources.workGroupSize) !=
+                0) {
+            return 1;
+        }
+
+        // Restore evicted buffers and rebind the ones that moved
+        pinned.reserve(kernelHandle->bindings.size());
+        for (BufferBinding &binding : kernelHandle->bindings) {
+            PEASYOCL_HOST_STAGE(_hostCounters, Bind);
+            int touched = _memory.Touch(*binding.entry, true);
+            pinned.push_back(binding.entry);
+            if (touched != 0) {
+                unpin();
+                return 1;
+            }
+            if (binding.generation != binding.entry->generation) {
+                cl_mem mem;
+                {
+                    std::lock_guard<std::mutex> lock(
+                        binding.entry->bufferMutex);
+                    mem = (*binding.entry->buffer)();
+                }
+                utils::InvalidateShadow(kernelHandle->shadow, binding.index);
+                kernelHandle->BindArgument(binding.index, sizeof(cl_mem),
+                                           &mem);
+                binding.generation = binding.entry->generation;
+                kernelHandle->rebinds++;
+            }
+        }
+
+        // Copy the arguments to the instance, skipping the ones it already
+        // has. A moved buffer is bound again even if its address was reused
+        PEASYOCL_HOST_STAGE(_hostCounters, SetArgument);
+        if (instance->rebinds != kernelHandle->rebinds) {
+            for (const BufferBinding &binding : kernelHandle->bindings) {
+                utils::InvalidateShadow(instance->shadow, binding.index);
+            }
+            instance->rebinds = kernelHandle->rebinds;
+        }
+        for (size_t i = 0; i < kernelHandle->shadow.size(); i++) {
+            const ArgumentShadow &arg = kernelHandle->shadow[i];
+            if (!arg.bound) {
+                continue;
+            }
+            cl_int err = utils::BindShadowed(
+                instance->kernel, instance->shadow, static_cast<int>(i),
+                arg.size, arg.null ? nullptr : arg.bytes.data(), nullptr);
+            if (err != CL_SUCCESS) {
+                printf("Error: Failed to set argument %zu of kernel %s! %i\n",
+                       i, kernelHandle->key.c_str(), err);
+                unpin();
+                return 1;
+            }
+        }
+    }
+
+    // Keep the mirror uploads and the launch together on the queue
+    std::unique_lock<std::mutex> submit(_submitMutex);
+    for (SharedMirror &mirror : kernelHandle->mirrors) {
+        PEASYOCL_HOST_STAGE(_hostCounters, MirrorSync);
+        // Sync writes one range per event
+        std::vector<std::pair<size_t, size_t>> ranges;
+        std::vector<cl::Event> uploads;
+        BufferPin pin = PinBuffer(mirror->Buffer());
+        if (!pin || mirror->Sync(_queue, pin.Get(),
+                                 _profiling ? &uploads : nullptr,
+                                 _profiling ? &ranges : nullptr) != 0) {
+            unpin();
+            return 1;
+        }
+        for (size_t i = 0; i < uploads.size(); i++) {
+            ProfileTransfer(mirror->Buffer(), uploads[i],
+                            TransferDirection::Upload, ranges[i].second);
+        }
+    }
+
     cl::Event ev;
-    err = _queue.enqueueNDRangeKernel(kernelHandle->kernel, cl::NullRange,
-                                      cl::NDRange(global), cl::NullRange, NULL,
-                                      &ev);
-    ev.wait();
+    cl_int err;
+    const cl::NDRange range = local > 0 ? cl::NDRange(local) : cl::NullRange;
+    {
+        PEASYOCL_HOST_STAGE(_hostCounters, Enqueue);
+        err = _queue.enqueueNDRangeKernel(instance->kernel, cl::NullRange,
+                                          cl::NDRange(global), range, NULL,
+                                          &ev);
+        if (err == CL_MEM_OBJECT_ALLOCATION_FAILURE &&
+            _memory.EvictUnused() > 0) {
+            err = _queue.enqueueNDRangeKernel(instance->kernel, cl::NullRange,
+                                              cl::NDRange(global), range, NULL,
+                                              &ev);
+        }
+    }
+    submit.unlock();
+    unpin();
+    instance->event = ev;
+
+    if (err == CL_SUCCESS) {
+        {
+            TraceScope wait(_trace, "wait", kernelHandle->key);
+            PEASYOCL_HOST_STAGE(_hostCounters, Wait);
+            ev.wait();
+        }
+        if (_profiling) {
+            _profiler.Record(kernelHandle->key, ev, true);
+            _trace.RecordDevice("kernel", kernelHandle->key, ev);
+        }
+    }
     // _queue.finish();
     // _queue.flush();
     if (err != CL_SUCCESS) {
@@ -231,11 +936,474 @@ int Context::Execute(const size_t &global, KernelHandle *kernelHandle) {
     return 0;
 }
 
+/**
+ * @brief Map size bytes of buffer, let convert fill or drain the mapping, and
+ * unmap it again. Blocks until the unmap is done
+ *
+ */
+template <typename Convert>
+static int ConvertMapped(Context *ctx, cl::CommandQueue &queue,
+                         SharedBuffer buffer, cl_map_flags flags,
+                         const size_t &size, Convert convert) {
+    if (buffer == nullptr) {
+        printf("Error: Failed to map buffer, buffer is null!\n");
+        return 1;
+    }
+    if (size == 0) {
+        return 0;
+    }
+    BufferPin pin = ctx->PinBuffer(buffer);
+    if (!pin) {
+        return 1;
+    }
+
+    cl_int err;
+    cl::Event mapEvent;
+    void *mapped = queue.enqueueMapBuffer(pin.Get(), CL_TRUE, flags, 0, size,
+                                          nullptr, &mapEvent, &err);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to map buffer! %i\n", err);
+        return 1;
+    }
+
+    convert(static_cast<float *>(mapped));
+
+    cl::Event ev;
+    err = queue.enqueueUnmapMemObject(pin.Get(), mapped, nullptr, &ev);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to unmap buffer! %i\n", err);
+        return 1;
+    }
+    ev.wait();
+
+    // Reads transfer on map and writes on unmap
+    if (flags == CL_MAP_READ) {
+        ctx->ProfileTransfer(buffer, mapEvent, TransferDirection::Download,
+                             size);
+    } else {
+        ctx->ProfileTransfer(buffer, ev, TransferDirection::Upload, size);
+    }
+    return 0;
+}
+
+int KernelHandle::SetBufferDataFloat3(const float *data, SharedBuffer buffer,
+                                      const size_t &count) {
+    dirty = true;
+    return ConvertMapped(owner, *queue, buffer,
+                         CL_MAP_WRITE_INVALIDATE_REGION,
+                         count * 4 * sizeof(float), [&](float *mapped) {
+                             utils::PackFloat3ToFloat4(data, mapped, count);
+                         });
+}
+
+int KernelHandle::SetBufferDataFloat3(const float *data,
+                                      const std::string &name,
+                                      const size_t &count) {
+    if (arguments.find(name) == arguments.end()) {
+        printf("Error: Buffer %s is not recognized!\n", name.c_str());
+        return 1;
+    }
+    return SetBufferDataFloat3(data, owner->GetBuffer(name), count);
+}
+
+int KernelHandle::ReadBufferDataFloat3(float *data, SharedBuffer buffer,
+                                       const size_t &count) {
+    return ConvertMapped(owner, *queue, buffer, CL_MAP_READ,
+                         count * 4 * sizeof(float), [&](float *mapped) {
+                             utils::UnpackFloat4ToFloat3(mapped, data, count);
+                         });
+}
+
+int KernelHandle::ReadBufferDataFloat3(float *data, const std::string &name,
+                                       const size_t &count) {
+    return ReadBufferDataFloat3(data, owner->GetBuffer(name), count);
+}
+
+int KernelHandle::SetBufferDataSoA(const float *data, SharedBuffer buffer,
+                                   const size_t &count,
+                                   const size_t &components) {
+    dirty = true;
+    return ConvertMapped(owner, *queue, buffer,
+                         CL_MAP_WRITE_INVALIDATE_REGION,
+                         count * components * sizeof(float),
+                         [&](float *mapped) {
+                             utils::AosToSoa(data, mapped, count, components);
+                         });
+}
+
+int KernelHandle::SetBufferDataSoA(const float *data, const std::string &name,
+                                   const size_t &count,
+                                   const size_t &components) {
+    if (arguments.find(name) == arguments.end()) {
+        printf("Error: Buffer %s is not recognized!\n", name.c_str());
+        return 1;
+    }
+    return SetBufferDataSoA(data, owner->GetBuffer(name), count, components);
+}
+
+int KernelHandle::ReadBufferDataSoA(float *data, SharedBuffer buffer,
+                                    const size_t &count,
+                                    const size_t &components) {
+    return ConvertMapped(owner, *queue, buffer, CL_MAP_READ,
+                         count * components * sizeof(float),
+                         [&](float *mapped) {
+                             utils::SoaToAos(mapped, data, count, components);
+                         });
+}
+
+int KernelHandle::ReadBufferDataSoA(float *data, const std::string &name,
+                                    const size_t &count,
+                                    const size_t &components) {
+    return ReadBufferDataSoA(data, owner->GetBuffer(name), count, components);
+}
+
+int KernelHandle::GatherBufferData(const std::vector<UploadSpan> &spans,
+                                   SharedBuffer buffer) {
+    if (buffer == nullptr) {
+        printf("Error: Failed to gather data, buffer is null!\n");
+        return 1;
+    }
+    BufferPin pin = owner->PinBuffer(buffer);
+    if (!pin) {
+        return 1;
+    }
+
+    // The queue is in-order, so waiting on the last write covers all of them
+    std::vector<UploadSpan> merged = MergeSpans(spans);
+    std::vector<cl::Event> events;
+    for (const UploadSpan &span : merged) {
+        cl::Event ev;
+        cl_int err = queue->enqueueWriteBuffer(pin.Get(), CL_FALSE, span.offset,
+                                               span.size, span.data, nullptr,
+                                               &ev);
+        if (err != CL_SUCCESS) {
+            printf("Error: Failed to gather data to buffer! %i\n", err);
+            break;
+        }
+        events.push_back(ev);
+    }
+    if (!events.empty()) {
+        events.back().wait();
+    }
+    for (size_t i = 0; i < events.size(); i++) {
+        owner->ProfileTransfer(
+            buffer, events[i], TransferDirection::Upload, merged[i].size);
+    }
+    dirty = true;
+    return events.size() == merged.size() ? 0 : 1;
+}
+
+int KernelHandle::GatherBufferData(const std::vector<UploadSpan> &spans,
+                                   const std::string &name) {
+    if (arguments.find(name) == arguments.end()) {
+        printf("Error: Buffer %s is not recognized!\n", name.c_str());
+        return 1;
+    }
+    return GatherBufferData(spans, owner->GetBuffer(name));
+}
+
+int KernelHandle::ScatterBufferData(const std::vector<ReadbackSpan> &spans,
+                                    SharedBuffer buffer) {
+    if (buffer == nullptr) {
+        printf("Error: Failed to scatter data, buffer is null!\n");
+        return 1;
+    }
+    BufferPin pin = owner->PinBuffer(buffer);
+    if (!pin) {
+        return 1;
+    }
+
+    std::vector<ReadbackSpan> merged = MergeSpans(spans);
+    std::vector<cl::Event> events;
+    for (const ReadbackSpan &span : merged) {
+        cl::Event ev;
+        cl_int err = queue->enqueueReadBuffer(pin.Get(), CL_FALSE, span.offset,
+                                              span.size, span.data, nullptr,
+                                              &ev);
+        if (err != CL_SUCCESS) {
+            printf("Error: Failed to scatter data from buffer! %i\n", err);
+            break;
+        }
+        events.push_back(ev);
+    }
+    if (!events.empty()) {
+        events.back().wait();
+    }
+    for (size_t i = 0; i < events.size(); i++) {
+        owner->ProfileTransfer(
+            buffer, events[i], TransferDirection::Download, merged[i].size);
+    }
+    return events.size() == merged.size() ? 0 : 1;
+}
+
+int KernelHandle::ScatterBufferData(const std::vector<ReadbackSpan> &spans,
+                                    const std::string &name) {
+    return ScatterBufferData(spans, owner->GetBuffer(name));
+}
+
+/**
+ * @brief Stream an opened file into buffer on the queue of handle, and
+ * profile each chunk written
+ *
+ */
+static int StreamMapped(KernelHandle &handle, MappedFile &file,
+                        SharedBuffer buffer, const size_t &bufferOffset,
+                        const size_t &fileOffset, const size_t &size,
+                        const size_t &chunkSize) {
+    if (buffer == nullptr) {
+        printf("Error: Failed to stream file, buffer is null!\n");
+        return 1;
+    }
+    BufferPin pin = handle.owner->PinBuffer(buffer);
+    if (!pin) {
+        return 1;
+    }
+
+    handle.dirty = true;
+    std::vector<std::pair<cl::Event, size_t>> writes;
+    int err = utils::StreamFile(*handle.context, *handle.queue, file, pin.Get(),
+                                bufferOffset, fileOffset, size, chunkSize,
+                                handle.owner->IsProfiling() ? &writes
+                                                            : nullptr);
+    for (auto &[ev, bytes] : writes) {
+        handle.owner->ProfileTransfer(buffer, ev, TransferDirection::Upload,
+                                      bytes);
+    }
+    return err;
+}
+
+int KernelHandle::StreamBufferData(const std::string &path,
+                                   SharedBuffer buffer,
+                                   const size_t &bufferOffset,
+                                   const size_t &fileOffset,
+                                   const size_t &size,
+                                   const size_t &chunkSize) {
+    MappedFile file;
+    if (file.Open(path) != 0) {
+        return 1;
+    }
+    return StreamMapped(*this, file, std::move(buffer), bufferOffset,
+                        fileOffset, size, chunkSize);
+}
+
+int KernelHandle::StreamBufferData(const std::string &path,
+                                   const std::string &name) {
+    MappedFile file;
+    if (file.Open(path) != 0) {
+        return 1;
+    }
+    size_t size = std::min(file.Size(), owner->GetBufferSize(name));
+    return StreamMapped(*this, file, owner->GetBuffer(name), 0, 0, size,
+                        utils::DefaultStreamChunkSize);
+}
+
+int KernelHandle::StreamBufferData(const std::string &path,
+                                   const std::string &name,
+                                   const size_t &bufferOffset,
+                                   const size_t &fileOffset,
+                                   const size_t &size,
+                                   const size_t &chunkSize) {
+    return StreamBufferData(path, owner->GetBuffer(name), bufferOffset,
+                            fileOffset, size, chunkSize);
+}
+
+int KernelHandle::CopyBuffer(SharedBuffer src, SharedBuffer dst,
+                             const size_t &srcOffset, const size_t &dstOffset,
+                             const size_t &size, cl::Event *event) {
+    if (src == nullptr || dst == nullptr) {
+        printf("Error: Failed to copy buffer, buffer is null!\n");
+        return 1;
+    }
+    BufferPin srcPin = owner->PinBuffer(src);
+    if (!srcPin) {
+        return 1;
+    }
+    BufferPin dstPin = owner->PinBuffer(dst);
+    if (!dstPin) {
+        return 1;
+    }
+
+    cl::Event ev;
+    cl_int err = queue->enqueueCopyBuffer(srcPin.Get(), dstPin.Get(), srcOffset,
+                                          dstOffset, size, nullptr, &ev);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to copy buffer! %i\n", err);
+        return 1;
+    }
+    dirty = true;
+    owner->ProfileTransfer(dst, ev, TransferDirection::Copy, size);
+    if (event) {
+        *event = ev;
+    }
+    return 0;
+}
+
+int KernelHandle::CopyBuffer(const std::string &src, const std::string &dst) {
+    size_t size =
+        std::min(owner->GetBufferSize(src), owner->GetBufferSize(dst));
+    return CopyBuffer(owner->GetBuffer(src), owner->GetBuffer(dst), 0, 0,
+                      size);
+}
+
+int KernelHandle::CopyBuffer(const std::string &src, const std::string &dst,
+                             const size_t &srcOffset, const size_t &dstOffset,
+                             const size_t &size, cl::Event *event) {
+    return CopyBuffer(owner->GetBuffer(src), owner->GetBuffer(dst), srcOffset,
+                      dstOffset, size, event);
+}
+
+int KernelHandle::CopyBufferRect(
+    SharedBuffer src, SharedBuffer dst, const cl::array<size_t, 3> &srcOrigin,
+    const cl::array<size_t, 3> &dstOrigin, const cl::array<size_t, 3> &region,
+    const size_t &srcRowPitch, const size_t &srcSlicePitch,
+    const size_t &dstRowPitch, const size_t &dstSlicePitch,
+    cl::Event *event) {
+    if (src == nullptr || dst == nullptr) {
+        printf("Error: Failed to copy buffer, buffer is null!\n");
+        return 1;
+    }
+    BufferPin srcPin = owner->PinBuffer(src);
+    if (!srcPin) {
+        return 1;
+    }
+    BufferPin dstPin = owner->PinBuffer(dst);
+    if (!dstPin) {
+        return 1;
+    }
+
+    cl::Event ev;
+    cl_int err = queue->enqueueCopyBufferRect(
+        srcPin.Get(), dstPin.Get(), srcOrigin, dstOrigin, region, srcRowPitch,
+        srcSlicePitch, dstRowPitch, dstSlicePitch, nullptr, &ev);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to copy buffer region! %i\n", err);
+        return 1;
+    }
+    dirty = true;
+    owner->ProfileTransfer(dst, ev, TransferDirection::Copy,
+                           region[0] * region[1] * region[2]);
+    if (event) {
+        *event = ev;
+    }
+    return 0;
+}
+
+int KernelHandle::CopyBufferRect(
+    const std::string &src, const std::string &dst,
+    const cl::array<size_t, 3> &srcOrigin,
+    const cl::array<size_t, 3> &dstOrigin, const cl::array<size_t, 3> &region,
+    const size_t &srcRowPitch, const size_t &srcSlicePitch,
+    const size_t &dstRowPitch, const size_t &dstSlicePitch,
+    cl::Event *event) {
+    return CopyBufferRect(owner->GetBuffer(src), owner->GetBuffer(dst),
+                          srcOrigin, dstOrigin, region, srcRowPitch,
+                          srcSlicePitch, dstRowPitch, dstSlicePitch, event);
+}
+
 void Context::Finish() {
+    TraceScope trace(_trace, "wait", "Finish");
     _queue.finish();
     _queue.flush();
 }
 
+int Context::OnComplete(const cl::Event &event, EventCallback callback) {
+    return _dispatcher.Watch(event, std::move(callback));
+}
+
+void Context::ProfileTransfer(const SharedBuffer &buffer,
+                              const cl::Event &event,
+                              const TransferDirection &direction,
+                              const size_t &bytes) {
+    if (!_profiling) {
+        return;
+    }
+    BufferEntry *entry = GetBufferEntry(buffer);
+    ProfileTransfer(entry ? entry->name : "<unnamed>", event, direction, bytes);
+}
+
+void Context::ProfileTransfer(const std::string &name, const cl::Event &event,
+                              const TransferDirection &direction,
+                              const size_t &bytes) {
+    if (!_profiling) {
+        return;
+    }
+    cl_int status = CL_COMPLETE;
+    event.getInfo(CL_EVENT_COMMAND_EXECUTION_STATUS, &status);
+    if (status == CL_COMPLETE) {
+        _profiler.RecordTransfer(name, event, direction, bytes);
+        _trace.RecordDevice("transfer", name, event);
+        return;
+    }
+    OnComplete(event, [this, name, event, direction, bytes](cl_int status) {
+        if (status == CL_COMPLETE) {
+            _profiler.RecordTransfer(name, event, direction, bytes);
+            _trace.RecordDevice("transfer", name, event);
+        }
+    });
+}
+
+void Context::PrintTransferReport() const {
+    printf("%-24s %10s %14s %12s %10s\n", "Buffer", "Transfers", "Bytes",
+           "Time (us)", "GB/s");
+    auto print = [](const char *name, const char *direction,
+                    const TransferCounters &counters) {
+        if (counters.count == 0) {
+            return;
+        }
+        printf("%-15s %-8s %10zu %14zu %12.1f %10.2f\n", name, direction,
+               counters.count, counters.bytes, counters.time / 1000.0,
+               counters.Bandwidth());
+    };
+    for (const TransferStats &stats : GetTransferReport()) {
+        print(stats.name.c_str(), "upload", stats.upload);
+        print(stats.name.c_str(), "download", stats.download);
+        print(stats.name.c_str(), "copy", stats.copy);
+    }
+}
+
+void Context::PrintResourceReport() const {
+    std::vector<const KernelHandle *> handles;
+    _kernels.ForEach([&](const std::string &, const KernelHandle &handle) {
+        if (handle.built) {
+            handles.push_back(&handle);
+        }
+    });
+    std::stable_sort(handles.begin(), handles.end(),
+                     [](const KernelHandle *a, const KernelHandle *b) {
+                         return a->resources.occupancy <
+                                b->resources.occupancy;
+                     });
+
+    printf("%-24s %9s %9s %10s %10s %10s  %s\n", "Kernel", "Occupancy",
+           "WG size", "Multiple", "Private", "Local", "Flags");
+    for (const KernelHandle *handle : handles) {
+        const KernelResources &r = handle->resources;
+        std::string flags;
+        if (r.usesPrivateMemory) {
+            flags += "private-memory ";
+        }
+        if (r.belowDeviceWorkGroupSize) {
+            flags += "below-device-wg-size ";
+        }
+        if (r.localMemoryLimited) {
+            flags += "local-memory-limited";
+        }
+        printf("%-24s %8.0f%% %4zu/%-4zu %10zu %10llu %10llu  %s\n",
+               handle->key.c_str(), r.occupancy * 100.0, r.workGroupSize,
+               r.deviceMaxWorkGroupSize, r.preferredMultiple,
+               static_cast<unsigned long long>(r.privateMemSize),
+               static_cast<unsigned long long>(r.localMemSize), flags.c_str());
+    }
+}
+
+int Context::SetTracing(const bool enabled) {
+    if (enabled && SetProfiling(true) != 0) {
+        return 1;
+    }
+    _trace.SetEnabled(enabled);
+    return 0;
+}
+
 cl::string Context::_LoadShader(const std::string_view &fileName, int *err) {
     utils::ClFile kernelFile = utils::ClFile::GetClFileByName(fileName.data());
     if (kernelFile.empty()) {
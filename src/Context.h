@@ -15,14 +15,33 @@
 #ifndef OCL_DEFORMER_CONTEXT_H
 #define OCL_DEFORMER_CONTEXT_H
 
-#define CL_HPP_TARGET_OPENCL_VERSION 120
-#define CL_HPP_MINIMUM_OPENCL_VERSION 120
-
+#include "EventDispatcher.h"
+#include "HostCounters.h"
+#include "FileStream.h"
+#include "HostMirror.h"
+#include "ImageMap.h"
+#include "KernelArgInfo.h"
+#include "KernelPool.h"
+#include "KernelResources.h"
 #include "KernelUtils.h"
-#include "opencl.hpp"
+#include "Layout.h"
+#include "MemoryManager.h"
+#include "Profiler.h"
+#include "ProgramCache.h"
+#include "ShardedMap.h"
+#include "StructLayout.h"
+#include "TraceRecorder.h"
+#include "TransferBatch.h"
+#include "Types.h"
+#include <algorithm>
+#include <atomic>
+#include <functional>
 #include <map>
+#include <mutex>
 #include <string>
+#include <type_traits>
 #include <unordered_map>
+#include <utility>
 
 namespace peasyocl {
 
@@ -31,28 +50,167 @@ namespace peasyocl {
  *
  */
 
+class Context;
 struct KernelHandle;
 
-using SharedBuffer = std::shared_ptr<cl::Buffer>;
-using KernelMap = std::map<cl::string, KernelHandle>;
+using KernelMap = ShardedMap<std::string, KernelHandle>;
 using ArgumentMap = std::unordered_map<std::string, int>;
-using BufferMap =
-    std::unordered_map<std::string, std::pair<SharedBuffer, size_t>>;
+
+/**
+ * @brief A buffer bound to a kernel argument. The generation is compared
+ * against the entry to rebind the argument after the buffer was restored
+ *
+ */
+struct BufferBinding {
+    BufferEntry *entry;
+    int index;
+    unsigned generation;
+};
+
+/**
+ * @brief Result of adding an image, sampler or __local argument. Every Add
+ * call of KernelHandle returns an ArgStatus or ArgHandle, which converts to
+ * true if the argument was added
+ *
+ */
+struct ArgStatus {
+    int index = -1;
+    int status = 1;
+
+    bool IsValid() const { return status == 0 && index >= 0; }
+    explicit operator bool() const { return IsValid(); }
+};
+
+/**
+ * @brief Typed handle to a kernel argument, returned by AddArgument. Holds the
+ * argument index and, for buffer arguments, the buffer entry, so setting the
+ * argument needs no name lookup. Converts to true if AddArgument succeeded,
+ * like ArgStatus. Invalidated when the kernel is removed
+ *
+ * @tparam T Type of the scalar argument or of the buffer elements
+ */
+template <typename T> struct ArgHandle {
+    int index = -1;
+    BufferEntry *entry = nullptr;
+    int status = 1;
+
+    bool IsValid() const { return status == 0 && index >= 0; }
+    bool IsBuffer() const { return entry != nullptr; }
+    explicit operator bool() const { return IsValid(); }
+};
+
+/**
+ * @brief True if V converts to T without narrowing, as in T{value}
+ *
+ */
+template <typename T, typename V, typename = void>
+struct IsNonNarrowing : std::false_type {};
+
+template <typename T, typename V>
+struct IsNonNarrowing<T, V, std::void_t<decltype(T{std::declval<V>()})>>
+    : std::true_type {};
+
+/**
+ * @brief Computes the bytes of a __local argument from the work group size
+ *
+ */
+using LocalSizer = std::function<size_t(const size_t &localSize)>;
+
+/**
+ * @brief A __local argument, either of a fixed size or sized by sizer
+ *
+ */
+struct LocalArgument {
+    int index;
+    size_t size;
+    LocalSizer sizer;
+};
 
 struct KernelHandle {
     cl::Kernel kernel;
     ArgumentMap arguments;
     std::string key;
+    std::string kernelName;
+    // Context the kernel was added to, which holds its buffers
+    Context *owner = nullptr;
     cl::CommandQueue *queue;
     cl::Context *context;
     cl::Program program;
     std::string code;
+    std::vector<SharedMirror> mirrors;
+    std::vector<BufferBinding> bindings;
+    std::vector<ImageEntry *> images;
+    KernelResources resources;
+    // Parameter signatures, only filled when built with argument info
+    KernelArgList argInfo;
+    ShadowList shadow;
+    // setArg calls skipped because the argument was already bound
+    size_t elidedCalls = 0;
+    // Kernel objects for launching from several host threads
+    SharedKernelPool pool;
+    // Held by Execute while it updates the arguments on kernel and copies
+    // them to the calling thread's instance
+    std::shared_ptr<std::mutex> argumentMutex;
+    // Number of buffer rebinds after a restore, compared by the instances
+    unsigned rebinds = 0;
+    std::vector<LocalArgument> locals;
+    // Work group size the sized __local arguments were computed for
+    size_t localSize = 0;
 
     bool built = false;
-    bool dirty = true;
+    // Set by every call that changes arguments or buffer data, from any
+    // thread, and cleared by Execute
+    std::atomic<bool> dirty{true};
 
     int argCount = 0;
 
+    /**
+     * @brief Get the index an argument binds to. Without argument info this
+     * is the next index in the order of AddArgument calls. With argument info
+     * it is the index of the kernel parameter called name, checked against
+     * whether a buffer is bound and against flags
+     *
+     * @param name Name of the argument
+     * @param buffer Whether a buffer is bound to the argument
+     * @param flags Flags of the buffer
+     * @return int -1 if name does not match the kernel signature
+     */
+    int BindIndex(const std::string &name, const bool buffer,
+                  const cl_mem_flags &flags = 0) const;
+
+    /**
+     * @brief Bind size bytes at value to argument index, unless exactly
+     * those bytes are already bound. Every argument set on kernel goes
+     * through here so the shadow state stays in sync
+     *
+     * @param index Argument index
+     * @param size Size in bytes
+     * @param value Bytes to bind, nullptr for __local arguments
+     * @return cl_int
+     */
+    cl_int BindArgument(const int index, const size_t &size,
+                        const void *value);
+
+    /**
+     * @brief Get the kernel instance of the calling thread. It starts with
+     * the arguments currently bound on kernel, and is only used by that
+     * thread, so threads can set arguments and launch concurrently
+     *
+     * @return KernelInstance* nullptr if the instance could not be created
+     */
+    KernelInstance *ThreadKernel() {
+        return pool ? pool->Local(&shadow, argumentMutex.get()) : nullptr;
+    }
+
+    /**
+     * @brief Get the signature of the kernel parameter called name
+     *
+     * @param name
+     * @return const KernelArgInfo* nullptr without argument info or if there
+     * is no such parameter
+     */
+    const KernelArgInfo *GetArgumentInfo(const std::string &name) const;
+
     /**
      * @brief Add argument to kernel and create buffer
      *
@@ -61,11 +219,11 @@ struct KernelHandle {
      * @param name Name associated with this argument
      * @param size Size of elements
      * @param data Data of type T
-     * @return int Success
+     * @return ArgHandle<T> Converts to true on success
      */
     template <typename T>
-    int AddArgument(cl_mem_flags flags, const std::string &name,
-                    const size_t &size, T *data);
+    ArgHandle<T> AddArgument(cl_mem_flags flags, const std::string &name,
+                             const size_t &size, T *data);
 
     /**
      * @brief Add argument to kernel and create buffer
@@ -75,11 +233,11 @@ struct KernelHandle {
      * @param name Name associated with this argument
      * @param size Size of elements
      * @param data Data of type const T&
-     * @return int Success
+     * @return ArgHandle<T> Converts to true on success
      */
     template <typename T>
-    int AddArgument(cl_mem_flags flags, const std::string &name,
-                    const size_t &size, const T &data);
+    ArgHandle<T> AddArgument(cl_mem_flags flags, const std::string &name,
+                             const size_t &size, const T &data);
 
     /**
      * @brief Add argument to kernel with option to create buffer. Allows one to
@@ -90,11 +248,144 @@ struct KernelHandle {
      * @param name Name associated with this argument
      * @param size Size of elements
      * @param createBuffer Whether to create an empty buffer. Defaults to true
-     * @return int Success
+     * @return ArgHandle<T> Converts to true on success
+     */
+    template <typename T>
+    ArgHandle<T> AddArgument(cl_mem_flags flags, const std::string &name,
+                             const size_t &size,
+                             const bool createBuffer = true);
+
+    /**
+     * @brief Add argument to kernel and create a buffer with a host mirror.
+     * Writes through WriteMirrorData are tracked per page and only the dirty
+     * ranges are uploaded at the next Execute
+     *
+     * @tparam T
+     * @param flags Flags passed to the cl::Buffer object
+     * @param name Name associated with this argument
+     * @param size Size of elements
+     * @param data Optional initial data of type T
+     * @param pageSize Granularity of the dirty tracking in bytes
+     * @return ArgHandle<T> Converts to true on success
+     */
+    template <typename T>
+    ArgHandle<T> AddMirroredArgument(cl_mem_flags flags, const std::string &name,
+                            const size_t &size, T *data = nullptr,
+                            const size_t &pageSize =
+                                HostMirror::DefaultPageSize);
+
+    /**
+     * @brief Add a struct argument passed by value with a single setArg.
+     * Check its layout with PEASYOCL_CHECK_STRUCT and PEASYOCL_CHECK_MEMBER,
+     * and update it through SetArgument with the returned handle
+     *
+     * @tparam T Trivially copyable struct
+     * @param name Name associated with this argument
+     * @param value Initial value
+     * @return ArgHandle<T> Converts to true on success
      */
     template <typename T>
-    int AddArgument(cl_mem_flags flags, const std::string &name,
-                    const size_t &size, const bool createBuffer = true);
+    ArgHandle<T> AddStructArgument(const std::string &name, const T &value);
+
+    /**
+     * @brief Add a struct argument in a read only buffer, for __constant
+     * parameters or structs too large to pass by value. Update it through
+     * SetBufferData with the returned handle
+     *
+     * @tparam T Trivially copyable struct
+     * @param name Name associated with this argument
+     * @param value Initial value
+     * @return ArgHandle<T> Converts to true on success
+     */
+    template <typename T>
+    ArgHandle<T> AddStructBuffer(const std::string &name, const T &value);
+
+    /**
+     * @brief Bind an image created with Context::CreateImage2D or
+     * CreateImage3D to the next argument
+     *
+     * @param name Name of the image
+     * @return ArgStatus Converts to true on success
+     */
+    ArgStatus AddImageArgument(const std::string &name);
+
+    /**
+     * @brief Add an image argument, creating the image if there is no image
+     * with name yet. An existing image must have the same format and extent
+     *
+     * @param flags Flags passed to the cl::Image object
+     * @param name Name associated with this argument
+     * @param format Channel order and type
+     * @param width Width in pixels
+     * @param height Height in pixels
+     * @param data Optional initial data, tightly packed
+     * @return ArgStatus Converts to true on success
+     */
+    ArgStatus AddImage2DArgument(cl_mem_flags flags, const std::string &name,
+                                 const cl::ImageFormat &format,
+                                 const size_t &width, const size_t &height,
+                                 const void *data = nullptr);
+    ArgStatus AddImage3DArgument(cl_mem_flags flags, const std::string &name,
+                                 const cl::ImageFormat &format,
+                                 const size_t &width, const size_t &height,
+                                 const size_t &depth,
+                                 const void *data = nullptr);
+
+    /**
+     * @brief Add a sampler argument, creating the sampler if there is no
+     * sampler with name yet
+     *
+     * @param name Name associated with this argument
+     * @param normalized Whether coordinates are normalized to [0, 1]
+     * @param addressing How coordinates outside the image are handled
+     * @param filter CL_FILTER_LINEAR for hardware interpolation
+     * @return ArgStatus Converts to true on success
+     */
+    ArgStatus
+    AddSamplerArgument(const std::string &name,
+                       const cl_bool &normalized = CL_TRUE,
+                       const cl_addressing_mode &addressing =
+                           CL_ADDRESS_CLAMP_TO_EDGE,
+                       const cl_filter_mode &filter = CL_FILTER_LINEAR);
+
+    /**
+     * @brief Write to or read from the whole image with name. Data is
+     * tightly packed rows of pixels
+     *
+     * @param data
+     * @param name Name of the image
+     * @return int
+     */
+    int SetImageData(const void *data, const std::string &name);
+    int ReadImageData(void *data, const std::string &name);
+
+    /**
+     * @brief Add a __local argument of size bytes
+     *
+     * @param name Name associated with this argument
+     * @param size Size in bytes
+     * @return ArgStatus Converts to true on success
+     */
+    ArgStatus AddLocalArgument(const std::string &name, const size_t &size);
+
+    /**
+     * @brief Add a __local argument whose size depends on the work group
+     * size. It is resized whenever Execute runs with a different local size
+     *
+     * @param name Name associated with this argument
+     * @param sizer Returns the size in bytes for a work group size
+     * @return ArgStatus Converts to true on success
+     */
+    ArgStatus AddLocalArgument(const std::string &name, LocalSizer sizer);
+
+    /**
+     * @brief Recompute the sized __local arguments for a work group size.
+     * Does nothing if they were already computed for localSize
+     *
+     * @param size Work group size
+     * @return int
+     */
+    int SizeLocalArguments(const size_t &size);
 
     /**
      * @brief Set the Argument at index argIndex to data
@@ -143,6 +434,37 @@ struct KernelHandle {
     template <typename T>
     int SetArgument(const std::string &name, const T &data);
 
+    /**
+     * @brief Set a scalar argument through its handle. The value must
+     * convert to the argument's type without narrowing, which is checked at
+     * compile time
+     *
+     * @tparam T
+     * @tparam V
+     * @param arg Handle returned by AddArgument
+     * @param data Value to set
+     * @return int
+     */
+    template <typename T, typename V>
+    int SetArgument(const ArgHandle<T> &arg, const V &data);
+
+    /**
+     * @brief Write to or read from the buffer of a buffer argument through
+     * its handle
+     *
+     * @tparam T
+     * @param data Data of the argument's element type
+     * @param arg Handle returned by AddArgument
+     * @param size Size in bytes, defaults to the whole buffer
+     * @return int
+     */
+    template <typename T>
+    int SetBufferData(const T *data, const ArgHandle<T> &arg,
+                      const size_t &size = 0);
+    template <typename T>
+    int ReadBufferData(T *data, const ArgHandle<T> &arg,
+                       const size_t &size = 0);
+
     /**
      * @brief Read data from buffer
      *
@@ -196,20 +518,329 @@ struct KernelHandle {
     template <typename T>
     int SetBufferData(T *data, const std::string &name,
                       const size_t &size);
+
+    /**
+     * @brief Start writing data to buffer without waiting for it. data must
+     * stay valid until the write has completed
+     *
+     * @tparam T
+     * @param data Of type T*
+     * @param buffer Buffer object to set
+     * @param size Size of elements to write
+     * @param event Optional event that completes with the write
+     * @param callback Optional callback run on the context's dispatcher
+     * thread once the write has completed
+     * @return int
+     */
+    template <typename T>
+    int SetBufferDataAsync(T *data, SharedBuffer buffer, const size_t size,
+                           cl::Event *event, EventCallback callback = nullptr);
+    template <typename T>
+    int SetBufferDataAsync(T *data, const std::string &name,
+                           const size_t &size, cl::Event *event,
+                           EventCallback callback = nullptr);
+
+    /**
+     * @brief Start reading buffer into data without waiting for it. data is
+     * only valid once the event or callback reports completion
+     *
+     * @tparam T
+     * @param data Result data to write to
+     * @param buffer Buffer object to read from
+     * @param size Size of elements to read
+     * @param event Optional event that completes with the read
+     * @param callback Optional callback run on the context's dispatcher
+     * thread once the data is ready
+     * @return int
+     */
+    template <typename T>
+    int ReadBufferDataAsync(T *data, SharedBuffer buffer, const size_t size,
+                            cl::Event *event, EventCallback callback = nullptr);
+    template <typename T>
+    int ReadBufferDataAsync(T *data, const std::string &name,
+                            const size_t &size, cl::Event *event,
+                            EventCallback callback = nullptr);
+
+    /**
+     * @brief Write data to the host mirror of buffer with name. The data is
+     * uploaded at the next Execute
+     *
+     * @tparam T
+     * @param data Of type T*
+     * @param name Buffer to write. Must be created with AddMirroredArgument
+     * @param offset Offset in bytes into the buffer
+     * @param size Size of elements to write
+     * @return int
+     */
+    template <typename T>
+    int WriteMirrorData(const T *data, const std::string &name,
+                        const size_t &offset, const size_t &size);
+
+    /**
+     * @brief Upload packed float3 elements into a buffer of float4 elements.
+     * The data is repacked straight into the mapped buffer
+     *
+     * @param data count * 3 floats
+     * @param buffer Buffer object of at least count float4 elements
+     * @param count Number of elements
+     * @return int
+     */
+    int SetBufferDataFloat3(const float *data, SharedBuffer buffer,
+                            const size_t &count);
+    int SetBufferDataFloat3(const float *data, const std::string &name,
+                            const size_t &count);
+
+    /**
+     * @brief Read a buffer of float4 elements into packed float3 elements
+     *
+     * @param data count * 3 floats to write to
+     * @param buffer Buffer object of at least count float4 elements
+     * @param count Number of elements
+     * @return int
+     */
+    int ReadBufferDataFloat3(float *data, SharedBuffer buffer,
+                             const size_t &count);
+    int ReadBufferDataFloat3(float *data, const std::string &name,
+                             const size_t &count);
+
+    /**
+     * @brief Upload interleaved elements into a buffer with one plane per
+     * component. The data is repacked straight into the mapped buffer
+     *
+     * @param data count * components floats, interleaved
+     * @param buffer Buffer object of at least count * components floats
+     * @param count Number of elements
+     * @param components Floats per element
+     * @return int
+     */
+    int SetBufferDataSoA(const float *data, SharedBuffer buffer,
+                         const size_t &count, const size_t &components);
+    int SetBufferDataSoA(const float *data, const std::string &name,
+                         const size_t &count, const size_t &components);
+
+    /**
+     * @brief Read a buffer with one plane per component into interleaved
+     * elements
+     *
+     * @param data count * components floats to write to
+     * @param buffer Buffer object of at least count * components floats
+     * @param count Number of elements
+     * @param components Floats per element
+     * @return int
+     */
+    int ReadBufferDataSoA(float *data, SharedBuffer buffer,
+                          const size_t &count, const size_t &components);
+    int ReadBufferDataSoA(float *data, const std::string &name,
+                          const size_t &count, const size_t &components);
+
+    /**
+     * @brief Gather non-contiguous host ranges into buffer. Each span is
+     * written straight from host memory to its offset, and spans that are
+     * contiguous on both sides are merged. Blocks until all writes are done
+     *
+     * @param spans Host ranges and their offsets in bytes into buffer
+     * @param buffer Buffer object to write to
+     * @return int
+     */
+    int GatherBufferData(const std::vector<UploadSpan> &spans,
+                         SharedBuffer buffer);
+    int GatherBufferData(const std::vector<UploadSpan> &spans,
+                         const std::string &name);
+
+    /**
+     * @brief Scatter ranges of buffer into non-contiguous host memory. Blocks
+     * until all reads are done
+     *
+     * @param spans Host ranges and their offsets in bytes into buffer
+     * @param buffer Buffer object to read from
+     * @return int
+     */
+    int ScatterBufferData(const std::vector<ReadbackSpan> &spans,
+                          SharedBuffer buffer);
+    int ScatterBufferData(const std::vector<ReadbackSpan> &spans,
+                          const std::string &name);
+
+    /**
+     * @brief Stream a file straight into buffer. The file is memory mapped
+     * and uploaded in chunks through pinned staging memory, so it is never
+     * fully resident in host memory. Blocks until the upload is done
+     *
+     * @param path Path of the file
+     * @param buffer Buffer object to write to
+     * @param bufferOffset Offset in bytes into buffer
+     * @param fileOffset Offset in bytes into the file
+     * @param size Bytes to stream. 0 streams to the end of the file
+     * @param chunkSize Size of each staging chunk in bytes
+     * @return int
+     */
+    int StreamBufferData(const std::string &path, SharedBuffer buffer,
+                         const size_t &bufferOffset, const size_t &fileOffset,
+                         const size_t &size,
+                         const size_t &chunkSize =
+                             utils::DefaultStreamChunkSize);
+
+    /**
+     * @brief Stream a file straight into buffer with name
+     *
+     * @param path Path of the file
+     * @param name Buffer to write. Name is associated with the name created
+     * with AddArgument function
+     * @return int
+     */
+    int StreamBufferData(const std::string &path, const std::string &name);
+    int StreamBufferData(const std::string &path, const std::string &name,
+                         const size_t &bufferOffset, const size_t &fileOffset,
+                         const size_t &size,
+                         const size_t &chunkSize =
+                             utils::DefaultStreamChunkSize);
+
+    /**
+     * @brief Fill a range of buffer with pattern on the device. Does not
+     * wait for the fill to finish
+     *
+     * @tparam T Pattern type. Size must be a power of two up to 128 bytes
+     * @param pattern Value to repeat over the range
+     * @param buffer Buffer object to fill
+     * @param offset Offset in bytes. Must be a multiple of sizeof(T)
+     * @param size Size in bytes. Must be a multiple of sizeof(T)
+     * @param event Optional event to wait on for completion
+     * @return int
+     */
+    template <typename T>
+    int FillBuffer(const T &pattern, SharedBuffer buffer, const size_t &offset,
+                   const size_t &size, cl::Event *event = nullptr);
+
+    /**
+     * @brief Fill buffer with name with pattern on the device
+     *
+     * @tparam T Pattern type. Size must be a power of two up to 128 bytes
+     * @param pattern Value to repeat over the buffer
+     * @param name Buffer to fill. Name is associated with the name created
+     * with AddArgument function
+     * @return int
+     */
+    template <typename T>
+    int FillBuffer(const T &pattern, const std::string &name);
+    template <typename T>
+    int FillBuffer(const T &pattern, const std::string &name,
+                   const size_t &offset, const size_t &size,
+                   cl::Event *event = nullptr);
+
+    /**
+     * @brief Copy a range from src to dst on the device. Does not wait for
+     * the copy to finish
+     *
+     * @param src Buffer object to copy from
+     * @param dst Buffer object to copy to
+     * @param srcOffset Offset in bytes into src
+     * @param dstOffset Offset in bytes into dst
+     * @param size Size in bytes to copy
+     * @param event Optional event to wait on for completion
+     * @return int
+     */
+    int CopyBuffer(SharedBuffer src, SharedBuffer dst, const size_t &srcOffset,
+                   const size_t &dstOffset, const size_t &size,
+                   cl::Event *event = nullptr);
+
+    /**
+     * @brief Copy buffer with name src to buffer with name dst on the device.
+     * Copies the size of the smaller buffer
+     *
+     * @param src Name of buffer to copy from
+     * @param dst Name of buffer to copy to
+     * @return int
+     */
+    int CopyBuffer(const std::string &src, const std::string &dst);
+    int CopyBuffer(const std::string &src, const std::string &dst,
+                   const size_t &srcOffset, const size_t &dstOffset,
+                   const size_t &size, cl::Event *event = nullptr);
+
+    /**
+     * @brief Copy a 2D or 3D region from src to dst on the device. Origins
+     * and region are given as (bytes, rows, slices)
+     *
+     * @param src Buffer object to copy from
+     * @param dst Buffer object to copy to
+     * @param srcOrigin Origin in src
+     * @param dstOrigin Origin in dst
+     * @param region Size of the region to copy
+     * @param srcRowPitch Bytes per row in src. 0 uses region[0]
+     * @param srcSlicePitch Bytes per slice in src. 0 uses region[1] *
+     * srcRowPitch
+     * @param dstRowPitch Bytes per row in dst. 0 uses region[0]
+     * @param dstSlicePitch Bytes per slice in dst. 0 uses region[1] *
+     * dstRowPitch
+     * @param event Optional event to wait on for completion
+     * @return int
+     */
+    int CopyBufferRect(SharedBuffer src, SharedBuffer dst,
+                       const cl::array<size_t, 3> &srcOrigin,
+                       const cl::array<size_t, 3> &dstOrigin,
+                       const cl::array<size_t, 3> &region,
+                       const size_t &srcRowPitch, const size_t &srcSlicePitch,
+                       const size_t &dstRowPitch, const size_t &dstSlicePitch,
+                       cl::Event *event = nullptr);
+    int CopyBufferRect(const std::string &src, const std::string &dst,
+                       const cl::array<size_t, 3> &srcOrigin,
+                       const cl::array<size_t, 3> &dstOrigin,
+                       const cl::array<size_t, 3> &region,
+                       const size_t &srcRowPitch, const size_t &srcSlicePitch,
+                       const size_t &dstRowPitch, const size_t &dstSlicePitch,
+                       cl::Event *event = nullptr);
 };
 
 /**
- * @brief Singleton class to handle the opencl context
+ * @brief Handles an opencl context with its queue, buffers and kernels.
+ * GetInstance returns a shared default instance, and further instances can
+ * be created for other devices or independent workloads. Kernels, buffers,
+ * images and launches can be added, looked up and executed from several
+ * threads at once. Init, SetProfiling and RemoveKernel are not meant to run
+ * concurrently with other calls
  *
  */
 class Context {
   public:
+    Context() = default;
+    ~Context();
+    Context(const Context &) = delete;
+    Context(Context &&) = delete;
+    Context &operator=(const Context &) = delete;
+    Context &operator=(Context &&) = delete;
+
+    /**
+     * @brief Create the context and queue on the default device, or on device
+     *
+     * @return int
+     */
     int Init();
+    int Init(const cl::Device &device);
 
     /**
-     * @brief Get the Instance of the DeformerContext singleton
+     * @brief Enable or disable profiling. Recreates the queue with
+     * CL_QUEUE_PROFILING_ENABLE if the context is already initialized, so
+     * call it before creating transfer batches
      *
-     * @return DeformerContext*
+     * @param enabled
+     * @return int
+     */
+    int SetProfiling(const bool enabled);
+    bool IsProfiling() const { return _profiling; }
+    const cl::Device &GetDevice() const { return _device; }
+
+    /**
+     * @brief Build kernels added after this call with -cl-kernel-arg-info.
+     * Arguments then bind to the kernel parameter with the same name instead
+     * of by call order, and buffers are checked against the signature
+     *
+     * @param enabled
+     */
+    void SetArgumentInfo(const bool enabled) { _argumentInfo = enabled; }
+    bool HasArgumentInfo() const { return _argumentInfo; }
+
+    /**
+     * @brief Get the shared default instance
+     *
+     * @return Context*
      */
     static Context *GetInstance() {
         static Context *ctx = new Context();
@@ -271,13 +902,124 @@ class Context {
      * @return false If kernel does not exist
      */
     bool HasKernel(const std::string &name) {
-        return _kernels.find(name) != _kernels.end();
+        return _kernels.Contains(name);
     }
 
+    /**
+     * @brief Create a buffer with name and account for it in the memory
+     * budget. Least recently used buffers are evicted to make room if needed
+     *
+     * @param name Name associated with the buffer
+     * @param flags Flags passed to the cl::Buffer object
+     * @param size Size in bytes
+     * @return SharedBuffer nullptr on failure
+     */
+    SharedBuffer CreateBuffer(const std::string &name, cl_mem_flags flags,
+                              const size_t &size);
+
     void AddBuffer(const std::string &name, SharedBuffer buffer,
                    const size_t &size);
+
+    /**
+     * @brief Get the buffer with name. Restores the buffer if it was evicted,
+     * but it can be evicted again by another allocation. Enqueue work on it
+     * through a PinBuffer, as the transfers of KernelHandle do
+     *
+     * @param name
+     * @return SharedBuffer
+     */
     SharedBuffer GetBuffer(const std::string &name);
+    SharedBuffer GetBuffer(BufferEntry *entry);
+    BufferEntry *GetBufferEntry(const std::string &name);
+    BufferEntry *GetBufferEntry(const SharedBuffer &buffer);
     const size_t GetBufferSize(const std::string &name);
+
+    /**
+     * @brief Keep buffer on the device while work is enqueued on it. A
+     * buffer stored in the context is restored if it was evicted and is not
+     * evicted until the pin is destroyed
+     *
+     * @param buffer
+     * @return BufferPin Converts to false if buffer is null or could not be
+     * restored
+     */
+    BufferPin PinBuffer(const SharedBuffer &buffer);
+
+    /**
+     * @brief Attach a host mirror to the buffer with name. Returns the
+     * existing mirror if there already is one
+     *
+     * @param name Name of an existing buffer
+     * @param pageSize Granularity of the dirty tracking in bytes
+     * @return SharedMirror nullptr if there is no buffer with name
+     */
+    SharedMirror AddMirror(const std::string &name,
+                           const size_t &pageSize = HostMirror::DefaultPageSize);
+    SharedMirror GetMirror(const std::string &name);
+
+    /**
+     * @brief Create a 2D or 3D image and store it with name. Unused buffers
+     * are evicted to make room if needed, but images are never evicted. The
+     * image counts against the memory budget until the last kernel bound to
+     * it is removed
+     *
+     * @param name Name associated with the image
+     * @param flags Flags passed to the cl::Image object
+     * @param format Channel order and type
+     * @param width Width in pixels
+     * @param height Height in pixels
+     * @param depth Depth in pixels
+     * @return SharedImage nullptr on failure
+     */
+    SharedImage CreateImage2D(const std::string &name, cl_mem_flags flags,
+                              const cl::ImageFormat &format,
+                              const size_t &width, const size_t &height);
+    SharedImage CreateImage3D(const std::string &name, cl_mem_flags flags,
+                              const cl::ImageFormat &format,
+                              const size_t &width, const size_t &height,
+                              const size_t &depth);
+    SharedImage GetImage(const std::string &name);
+    ImageEntry *GetImageEntry(const std::string &name);
+
+    /**
+     * @brief Write to or read from the whole image with name
+     *
+     * @param name Name of the image
+     * @param data Host data
+     * @param rowPitch Bytes per row in data, 0 for tightly packed
+     * @param slicePitch Bytes per slice in data, 0 for tightly packed
+     * @return int
+     */
+    int WriteImage(const std::string &name, const void *data,
+                   const size_t &rowPitch = 0, const size_t &slicePitch = 0);
+    int ReadImage(const std::string &name, void *data,
+                  const size_t &rowPitch = 0, const size_t &slicePitch = 0);
+
+    /**
+     * @brief Create a sampler and store it with name. Returns the existing
+     * sampler if there already is one
+     *
+     * @param name Name associated with the sampler
+     * @param normalized Whether coordinates are normalized to [0, 1]
+     * @param addressing How coordinates outside the image are handled
+     * @param filter CL_FILTER_NEAREST or CL_FILTER_LINEAR
+     * @return cl::Sampler* nullptr on failure
+     */
+    cl::Sampler *CreateSampler(const std::string &name,
+                               const cl_bool &normalized,
+                               const cl_addressing_mode &addressing,
+                               const cl_filter_mode &filter);
+    cl::Sampler *GetSampler(const std::string &name);
+
+    /**
+     * @brief Set the device memory budget in bytes. Defaults to
+     * CL_DEVICE_GLOBAL_MEM_SIZE, and 0 resets to the default
+     *
+     * @param bytes
+     */
+    void SetMemoryBudget(const size_t &bytes) { _memory.SetBudget(bytes); }
+    size_t GetMemoryBudget() const { return _memory.GetBudget(); }
+    size_t GetMemoryUsage() const { return _memory.GetUsage(); }
     // const int GetBufferIndex(const std::string &name);
 
     /**
@@ -290,23 +1032,160 @@ class Context {
     int Execute(const size_t &global, const std::string &kernelName);
     int Execute(const size_t &global, KernelHandle *kernelHandle);
 
+    /**
+     * @brief Execute a kernel with an explicit work group size. Sized
+     * __local arguments are recomputed when local changes. Without a local
+     * size they are sized for the kernel's maximum work group size
+     *
+     * @param global Global workgroup size, a multiple of local
+     * @param local Work group size, 0 lets the implementation choose
+     * @param kernelName Name of kernel to execute
+     * @return int
+     */
+    int Execute(const size_t &global, const size_t &local,
+                const std::string &kernelName);
+    int Execute(const size_t &global, const size_t &local,
+                KernelHandle *kernelHandle);
+
     /**
      * @brief Flush and finish the queue
      *
      */
     void Finish();
 
+    /**
+     * @brief Call callback on the context's dispatcher thread once event
+     * has completed
+     *
+     * @param event Event to watch
+     * @param callback Called with CL_COMPLETE or a negative error code
+     * @return int
+     */
+    int OnComplete(const cl::Event &event, EventCallback callback);
+
+    /**
+     * @brief Create a batch that gathers many small writes into a single
+     * upload on this context's queue
+     *
+     * @return TransferBatch
+     */
+    TransferBatch CreateTransferBatch() {
+        return TransferBatch(_context, _queue, this);
+    }
+
+    /**
+     * @brief Record the timestamps and bytes of a transfer on buffer when
+     * profiling is enabled, and its device spans when tracing is enabled.
+     * Events that have not completed yet are recorded once they do
+     *
+     * @param buffer Buffer the transfer was on
+     * @param event Event of the transfer
+     * @param direction
+     * @param bytes Bytes moved by the transfer
+     */
+    void ProfileTransfer(const SharedBuffer &buffer, const cl::Event &event,
+                         const TransferDirection &direction,
+                         const size_t &bytes);
+    void ProfileTransfer(const std::string &name, const cl::Event &event,
+                         const TransferDirection &direction,
+                         const size_t &bytes);
+
+    /**
+     * @brief Get the timing statistics of a kernel key or a buffer name.
+     * Only collected while profiling is enabled
+     *
+     * @param key
+     * @return ProfileStats
+     */
+    ProfileStats GetKernelStats(const std::string &key) const {
+        return _profiler.GetKernelStats(key);
+    }
+    ProfileStats GetBufferStats(const std::string &name) const {
+        return _profiler.GetBufferStats(name);
+    }
+    ProfileMap GetKernelStats() const { return _profiler.GetKernelStats(); }
+    ProfileMap GetBufferStats() const { return _profiler.GetBufferStats(); }
+    void ResetStats() { _profiler.Reset(); }
+
+    /**
+     * @brief Get the bytes moved, device time and bandwidth of every buffer,
+     * ranked by total transfer time. Only collected while profiling is
+     * enabled
+     *
+     * @return TransferReport
+     */
+    TransferReport GetTransferReport() const {
+        return _profiler.GetTransferReport();
+    }
+    void PrintTransferReport() const;
+
+    /**
+     * @brief Enable or disable tracing of host and device activity. Device
+     * spans come from profiling events, so enabling tracing also enables
+     * profiling
+     *
+     * @param enabled
+     * @return int
+     */
+    int SetTracing(const bool enabled);
+    bool IsTracing() const { return _trace.IsEnabled(); }
+    TraceRecorder &GetTraceRecorder() { return _trace; }
+
+    /**
+     * @brief Write the recorded trace as Chrome trace event JSON. Open it in
+     * chrome://tracing or https://ui.perfetto.dev
+     *
+     * @param path
+     * @return int
+     */
+    int WriteTrace(const std::string &path) const {
+        return _trace.WriteChromeTrace(path);
+    }
+    void ClearTrace() { _trace.Clear(); }
+
+    /**
+     * @brief Host time spent in each stage of Execute and argument setting.
+     * Only collected when built with PEASYOCL_HOST_COUNTERS
+     *
+     * @return HostCounters&
+     */
+    HostCounters &GetHostCounters() { return _hostCounters; }
+    void PrintHostCounters() const { _hostCounters.Print(); }
+
+    /**
+     * @brief Get the compile time, source size, flags and cache hit or miss
+     * of every AddKernel build, ranked by compile time
+     *
+     * @return BuildReport
+     */
+    BuildReport GetBuildReport() const { return _programs.GetReport(); }
+    void PrintBuildReport() const { _programs.Print(); }
+
+    /**
+     * @brief Get the CL_PROGRAM_BUILD_LOG of the latest build of a kernel key
+     *
+     * @param key
+     * @return std::string Empty if key was never built
+     */
+    std::string GetBuildLog(const std::string &key) const {
+        BuildRecord record;
+        return _programs.GetRecord(key, &record) ? record.log : std::string();
+    }
+
+    /**
+     * @brief Print the resource usage and estimated occupancy of every built
+     * kernel, lowest occupancy first, and flag kernels that spill registers
+     * or are limited by local memory
+     *
+     */
+    void PrintResourceReport() const;
+
   protected:
     // Is true once everything is initialized
     std::map<std::string, bool> built;
     bool initialized = false;
 
   private:
-    Context() = default;
-    Context(const Context &) = delete;
-    Context(Context &&) = delete;
-    Context &operator=(const Context &) = delete;
-    Context &operator=(Context &&) = delete;
 
     cl::string _LoadShader(const std::string_view &fileName, int *err);
 
@@ -316,6 +1195,20 @@ class Context {
     cl::CommandQueue _queue;
     cl::Program _program;
     BufferMap _buffers;
+    ShardedMap<const cl::Buffer *, BufferEntry *> _bufferLookup;
+    std::mutex _mirrorMutex;
+    // Taken while submitting a launch with its uploads, not while waiting
+    std::mutex _submitMutex;
+    ImageMap _images;
+    SamplerMap _samplers;
+    MemoryManager _memory;
+    Profiler _profiler;
+    bool _profiling = false;
+    bool _argumentInfo = false;
+    TraceRecorder _trace;
+    HostCounters _hostCounters;
+    ProgramCache _programs;
+    EventDispatcher _dispatcher;
     ArgumentMap _arguments;
     KernelMap _kernels;
     cl::Device _device;
@@ -323,31 +1216,41 @@ class Context {
 };
 
 template <typename T>
-inline int KernelHandle::AddArgument(cl_mem_flags flags,
-                                     const std::string &name,
-                                     const size_t &size, T *data) {
+inline ArgHandle<T> KernelHandle::AddArgument(cl_mem_flags flags,
+                                              const std::string &name,
+                                              const size_t &size, T *data) {
     dirty = true;
 
-    if (auto buff = Context::GetInstance()->GetBuffer(name); buff == nullptr) {
-        SharedBuffer d_data =
-            std::make_shared<cl::Buffer>(*context, flags, size);
-        Context::GetInstance()->AddBuffer(name, d_data, size);
+    int index = BindIndex(name, true, flags);
+    if (index < 0) {
+        return {};
+    }
+
+    BufferEntry *entry = owner->GetBufferEntry(name);
+    if (entry == nullptr) {
+        if (!owner->CreateBuffer(name, flags, size)) {
+            return {};
+        }
+        entry = owner->GetBufferEntry(name);
     }
     if (data != nullptr) {
-        SetBufferData(data, Context::GetInstance()->GetBuffer(name), size);
+        SetBufferData(data, owner->GetBuffer(name), size);
     }
 
     SetArgument<cl_mem, cl::Buffer>(
-        argCount, Context::GetInstance()->GetBuffer(name).get());
-    arguments.insert({name, argCount});
+        index, owner->GetBuffer(name).get());
+    arguments.insert({name, index});
+    bindings.push_back({entry, index, entry->generation});
+    entry->users++;
     argCount++;
-    return 0;
+    return {index, entry, 0};
 }
 
 template <typename T>
-inline int KernelHandle::AddArgument(cl_mem_flags flags,
-                                     const std::string &name,
-                                     const size_t &size, const T &data) {
+inline ArgHandle<T> KernelHandle::AddArgument(cl_mem_flags flags,
+                                              const std::string &name,
+                                              const size_t &size,
+                                              const T &data) {
     // dirty = true;
     // SharedBuffer d_data = std::make_shared<cl::Buffer>(*context, flags,
     // size); SetBufferData(&data, d_data, size);
@@ -357,58 +1260,169 @@ inline int KernelHandle::AddArgument(cl_mem_flags flags,
     // arguments.insert({name, argCount});
     // argCount++;
     // return 0;
-    return AddArgument(flags, name, size, &data);
+    return AddArgument(flags, name, size, const_cast<T *>(&data));
 }
 
 template <typename T>
-inline int
+inline ArgHandle<T>
 KernelHandle::AddArgument(cl_mem_flags flags, const std::string &name,
                           const size_t &size, const bool createBuffer) {
     if (createBuffer) {
         return AddArgument<T>(flags, name, size, nullptr);
     }
-    SetArgument<T>(argCount, (T *)nullptr);
-    arguments.insert({name, argCount});
+    int index = BindIndex(name, false);
+    if (index < 0) {
+        return {};
+    }
+    SetArgument<T>(index, (T *)nullptr);
+    arguments.insert({name, index});
     argCount++;
-    return 0;
+    return {index, nullptr, 0};
+}
+
+template <typename T>
+inline ArgHandle<T> KernelHandle::AddStructArgument(const std::string &name,
+                                                    const T &value) {
+    static_assert(IsClStruct<T>::value,
+                  "Struct arguments must be trivially copyable");
+    int index = BindIndex(name, false);
+    if (index < 0) {
+        return {};
+    }
+    dirty = true;
+    if (SetArgument<T>(index, value) != 0) {
+        return {};
+    }
+    arguments.insert({name, index});
+    argCount++;
+    return {index, nullptr, 0};
+}
+
+template <typename T>
+inline ArgHandle<T> KernelHandle::AddStructBuffer(const std::string &name,
+                                                  const T &value) {
+    static_assert(IsClStruct<T>::value,
+                  "Struct arguments must be trivially copyable");
+    return AddArgument<T>(CL_MEM_READ_ONLY, name, sizeof(T),
+                          const_cast<T *>(&value));
+}
+
+template <typename T>
+inline ArgHandle<T>
+KernelHandle::AddMirroredArgument(cl_mem_flags flags, const std::string &name,
+                                  const size_t &size, T *data,
+                                  const size_t &pageSize) {
+    ArgHandle<T> arg = AddArgument<T>(flags, name, size, nullptr);
+    if (!arg.IsValid()) {
+        return arg;
+    }
+
+    SharedMirror mirror = owner->AddMirror(name, pageSize);
+    if (!mirror) {
+        printf("Error: Failed to create mirror for buffer %s!\n",
+               name.c_str());
+        arg.status = 1;
+        return arg;
+    }
+
+    if (std::find(mirrors.begin(), mirrors.end(), mirror) == mirrors.end()) {
+        mirrors.push_back(mirror);
+    }
+
+    if (data != nullptr) {
+        arg.status = mirror->Write(data, 0, size);
+    }
+    return arg;
 }
 
 template <typename mem, typename T>
 inline int KernelHandle::SetArgument(const int argIndex, T *data) {
     dirty = true;
-    kernel.setArg(argIndex, sizeof(mem), data);
-    return 0;
+    return BindArgument(argIndex, sizeof(mem), data) == CL_SUCCESS ? 0 : 1;
 }
 
 template <typename T>
 inline int KernelHandle::SetArgument(const int argIndex, const T &data) {
+    using Handler = cl::detail::KernelArgumentHandler<T>;
     dirty = true;
-    kernel.setArg<T>(argIndex, data);
-    return 0;
+    return BindArgument(argIndex, Handler::size(data), Handler::ptr(data)) ==
+                   CL_SUCCESS
+               ? 0
+               : 1;
 }
 
 template <typename mem, typename T>
 inline int KernelHandle::SetArgument(const std::string &name, T *data) {
-    SetArgument(arguments[name], data);
-    return 0;
+    auto found = arguments.find(name);
+    if (found == arguments.end()) {
+        printf("Error: Argument %s is not recognized!\n", name.c_str());
+        return 1;
+    }
+    return SetArgument<mem>(found->second, data);
 }
 
 template <typename T>
 inline int KernelHandle::SetArgument(const std::string &name, const T &data) {
-    SetArgument(arguments[name], data);
-    return 0;
+    auto found = arguments.find(name);
+    if (found == arguments.end()) {
+        printf("Error: Argument %s is not recognized!\n", name.c_str());
+        return 1;
+    }
+    return SetArgument(found->second, data);
+}
+
+template <typename T, typename V>
+inline int KernelHandle::SetArgument(const ArgHandle<T> &arg, const V &data) {
+    static_assert(IsNonNarrowing<T, const V &>::value,
+                  "Value narrows or does not convert to the argument type");
+    if (!arg.IsValid() || arg.IsBuffer()) {
+        printf("Error: Argument handle is not a valid scalar argument!\n");
+        return 1;
+    }
+    return SetArgument<T>(arg.index, T{data});
+}
+
+template <typename T>
+inline int KernelHandle::SetBufferData(const T *data, const ArgHandle<T> &arg,
+                                       const size_t &size) {
+    if (!arg.IsValid() || !arg.IsBuffer()) {
+        printf("Error: Argument handle is not a valid buffer argument!\n");
+        return 1;
+    }
+    return SetBufferData(data, owner->GetBuffer(arg.entry),
+                         size > 0 ? size : arg.entry->size);
+}
+
+template <typename T>
+inline int KernelHandle::ReadBufferData(T *data, const ArgHandle<T> &arg,
+                                        const size_t &size) {
+    if (!arg.IsValid() || !arg.IsBuffer()) {
+        printf("Error: Argument handle is not a valid buffer argument!\n");
+        return 1;
+    }
+    return ReadBufferData(data, owner->GetBuffer(arg.entry),
+                          size > 0 ? size : arg.entry->size);
 }
 
 template <typename T>
 inline int KernelHandle::SetBufferData(T *data, SharedBuffer buffer,
                                        const size_t size) {
-    cl_int err = queue->enqueueWriteBuffer(*buffer, CL_TRUE, 0, size, data);
+    TraceScope trace(owner->GetTraceRecorder(), "transfer", "SetBufferData");
+    BufferPin pin = owner->PinBuffer(buffer);
+    if (!pin) {
+        return 1;
+    }
+    cl::Event ev;
+    cl_int err =
+        queue->enqueueWriteBuffer(pin.Get(), CL_TRUE, 0, size, data, nullptr,
+                                  owner->IsProfiling() ? &ev : nullptr);
     if (err != CL_SUCCESS) {
         printf("%i \n", err);
         printf("Error: Failed to write data to source array!\n");
         return 1;
     }
     dirty = true;
+    owner->ProfileTransfer(buffer, ev, TransferDirection::Upload, size);
     return 0;
 }
 
@@ -420,8 +1434,8 @@ inline int KernelHandle::SetBufferData(T *data, const std::string &name) {
     }
 
     dirty = true;
-    return SetBufferData(data, Context::GetInstance()->GetBuffer(name),
-                         Context::GetInstance()->GetBufferSize(name));
+    return SetBufferData(data, owner->GetBuffer(name),
+                         owner->GetBufferSize(name));
 }
 
 template <typename T>
@@ -433,34 +1447,192 @@ inline int KernelHandle::SetBufferData(T *data, const std::string &name,
     }
 
     dirty = true;
-    return SetBufferData(data, Context::GetInstance()->GetBuffer(name),
-                         size);
+    return SetBufferData(data, owner->GetBuffer(name), size);
 }
 
 template <typename T>
 inline int KernelHandle::ReadBufferData(T *data, SharedBuffer buffer,
                                         const size_t size) {
-    cl_int err = queue->enqueueReadBuffer(*buffer, CL_TRUE, 0, size, data);
+    TraceScope trace(owner->GetTraceRecorder(), "transfer", "ReadBufferData");
+    BufferPin pin = owner->PinBuffer(buffer);
+    if (!pin) {
+        return 1;
+    }
+    cl::Event ev;
+    cl_int err = queue->enqueueReadBuffer(pin.Get(), CL_TRUE, 0, size, data,
+                                          nullptr,
+                                          owner->IsProfiling() ? &ev : nullptr);
     if (err != CL_SUCCESS) {
         printf("Error: Failed to read output array! %d\n", err);
         return 1;
     }
+    owner->ProfileTransfer(buffer, ev, TransferDirection::Download, size);
     return 0;
 }
 
 template <typename T>
 inline int KernelHandle::ReadBufferData(T *data,
                                         const std::string &name) {
-    return ReadBufferData(data, Context::GetInstance()->GetBuffer(name),
-                          Context::GetInstance()->GetBufferSize(name));
+    return ReadBufferData(data, owner->GetBuffer(name),
+                          owner->GetBufferSize(name));
 }
 
 template <typename T>
 inline int KernelHandle::ReadBufferData(T *data, const std::string &name,
                                         const size_t &size) {
     // return ReadBufferData(data, buffers[name].first, size);
-    return ReadBufferData(data, Context::GetInstance()->GetBuffer(name),
-                          size);
+    return ReadBufferData(data, owner->GetBuffer(name), size);
+}
+
+template <typename T>
+inline int KernelHandle::SetBufferDataAsync(T *data, SharedBuffer buffer,
+                                            const size_t size,
+                                            cl::Event *event,
+                                            EventCallback callback) {
+    TraceScope trace(owner->GetTraceRecorder(), "transfer",
+                     "SetBufferDataAsync");
+    BufferPin pin = owner->PinBuffer(buffer);
+    if (!pin) {
+        return 1;
+    }
+    cl::Event ev;
+    cl_int err = queue->enqueueWriteBuffer(pin.Get(), CL_FALSE, 0, size, data,
+                                           nullptr, &ev);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to write data to source array! %i\n", err);
+        return 1;
+    }
+    dirty = true;
+    owner->ProfileTransfer(buffer, ev, TransferDirection::Upload, size);
+
+    if (callback) {
+        queue->flush();
+        if (owner->OnComplete(ev, std::move(callback)) != 0) {
+            return 1;
+        }
+    }
+    if (event) {
+        *event = ev;
+    }
+    return 0;
+}
+
+template <typename T>
+inline int KernelHandle::SetBufferDataAsync(T *data, const std::string &name,
+                                            const size_t &size,
+                                            cl::Event *event,
+                                            EventCallback callback) {
+    if (arguments.find(name) == arguments.end()) {
+        printf("Error: Buffer %s is not recognized!\n", name.c_str());
+        return 1;
+    }
+    return SetBufferDataAsync(data, owner->GetBuffer(name), size, event,
+                              std::move(callback));
+}
+
+template <typename T>
+inline int KernelHandle::ReadBufferDataAsync(T *data, SharedBuffer buffer,
+                                             const size_t size,
+                                             cl::Event *event,
+                                             EventCallback callback) {
+    TraceScope trace(owner->GetTraceRecorder(), "transfer",
+                     "ReadBufferDataAsync");
+    BufferPin pin = owner->PinBuffer(buffer);
+    if (!pin) {
+        return 1;
+    }
+    cl::Event ev;
+    cl_int err = queue->enqueueReadBuffer(pin.Get(), CL_FALSE, 0, size, data,
+                                          nullptr, &ev);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to read output array! %d\n", err);
+        return 1;
+    }
+    owner->ProfileTransfer(buffer, ev, TransferDirection::Download, size);
+
+    if (callback) {
+        queue->flush();
+        if (owner->OnComplete(ev, std::move(callback)) != 0) {
+            return 1;
+        }
+    }
+    if (event) {
+        *event = ev;
+    }
+    return 0;
+}
+
+template <typename T>
+inline int KernelHandle::ReadBufferDataAsync(T *data, const std::string &name,
+                                             const size_t &size,
+                                             cl::Event *event,
+                                             EventCallback callback) {
+    return ReadBufferDataAsync(data, owner->GetBuffer(name), size, event,
+                               std::move(callback));
+}
+
+template <typename T>
+inline int KernelHandle::FillBuffer(const T &pattern, SharedBuffer buffer,
+                                    const size_t &offset, const size_t &size,
+                                    cl::Event *event) {
+    static_assert(sizeof(T) <= 128 && (sizeof(T) & (sizeof(T) - 1)) == 0,
+                  "Fill pattern size must be a power of two up to 128 bytes");
+
+    if (buffer == nullptr) {
+        printf("Error: Failed to fill buffer, buffer is null!\n");
+        return 1;
+    }
+    if (offset % sizeof(T) != 0 || size % sizeof(T) != 0) {
+        printf("Error: Fill range is not a multiple of the pattern size!\n");
+        return 1;
+    }
+
+    BufferPin pin = owner->PinBuffer(buffer);
+    if (!pin) {
+        return 1;
+    }
+    cl::Event ev;
+    cl_int err = queue->enqueueFillBuffer(pin.Get(), pattern, offset, size,
+                                          nullptr, &ev);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to fill buffer! %i\n", err);
+        return 1;
+    }
+    dirty = true;
+    owner->ProfileTransfer(buffer, ev, TransferDirection::Copy, size);
+    if (event) {
+        *event = ev;
+    }
+    return 0;
+}
+
+template <typename T>
+inline int KernelHandle::FillBuffer(const T &pattern,
+                                    const std::string &name) {
+    return FillBuffer(pattern, owner->GetBuffer(name), 0,
+                      owner->GetBufferSize(name));
+}
+
+template <typename T>
+inline int KernelHandle::FillBuffer(const T &pattern, const std::string &name,
+                                    const size_t &offset, const size_t &size,
+                                    cl::Event *event) {
+    return FillBuffer(pattern, owner->GetBuffer(name), offset, size, event);
+}
+
+template <typename T>
+inline int KernelHandle::WriteMirrorData(const T *data,
+                                         const std::string &name,
+                                         const size_t &offset,
+                                         const size_t &size) {
+    SharedMirror mirror = owner->GetMirror(name);
+    if (!mirror) {
+        printf("Error: Buffer %s has no mirror!\n", name.c_str());
+        return 1;
+    }
+
+    dirty = true;
+    return mirror->Write(data, offset, size);
 }
 
 } // namespace peasyocl
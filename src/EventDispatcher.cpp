@@ -0,0 +1,111 @@
+// Copyright 2024 viktorlanner
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "EventDispatcher.h"
+
+namespace peasyocl {
+
+namespace {
+
+struct WatchedEvent {
+    EventDispatcher *dispatcher;
+    EventCallback callback;
+};
+
+} // namespace
+
+EventDispatcher::~EventDispatcher() { Stop(); }
+
+int EventDispatcher::Watch(cl::Event event, EventCallback callback) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _Start();
+        _watched++;
+    }
+
+    WatchedEvent *watched = new WatchedEvent{this, std::move(callback)};
+    cl_int err = event.setCallback(CL_COMPLETE, &EventDispatcher::_OnComplete,
+                                   watched);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to set event callback! %i\n", err);
+        delete watched;
+        std::lock_guard<std::mutex> lock(_mutex);
+        _watched--;
+        _cv.notify_all();
+        return 1;
+    }
+    return 0;
+}
+
+void EventDispatcher::Post(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _Start();
+        _tasks.push_back(std::move(task));
+    }
+    _cv.notify_all();
+}
+
+void EventDispatcher::Stop() {
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (!_thread.joinable()) {
+            return;
+        }
+        _cv.wait(lock, [this] { return _watched == 0; });
+        _stopping = true;
+    }
+    _cv.notify_all();
+    _thread.join();
+}
+
+void CL_CALLBACK EventDispatcher::_OnComplete(cl_event /*event*/,
+                                              cl_int status, void *userData) {
+    WatchedEvent *watched = static_cast<WatchedEvent *>(userData);
+    EventDispatcher *dispatcher = watched->dispatcher;
+    {
+        std::lock_guard<std::mutex> lock(dispatcher->_mutex);
+        dispatcher->_tasks.push_back([watched, status] {
+            watched->callback(status);
+            delete watched;
+        });
+        dispatcher->_watched--;
+    }
+    dispatcher->_cv.notify_all();
+}
+
+void EventDispatcher::_Start() {
+    if (!_thread.joinable()) {
+        _stopping = false;
+        _thread = std::thread(&EventDispatcher::_Run, this);
+    }
+}
+
+void EventDispatcher::_Run() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true) {
+        _cv.wait(lock, [this] { return _stopping || !_tasks.empty(); });
+        if (_tasks.empty()) {
+            return;
+        }
+
+        std::function<void()> task = std::move(_tasks.front());
+        _tasks.pop_front();
+        lock.unlock();
+        task();
+        lock.lock();
+    }
+}
+
+} // namespace peasyocl
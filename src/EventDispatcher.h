@@ -0,0 +1,86 @@
+// Copyright 2024 viktorlanner
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef OCL_EVENT_DISPATCHER_H
+#define OCL_EVENT_DISPATCHER_H
+
+#include "Types.h"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace peasyocl {
+
+/**
+ * @brief Called once an event has completed. Status is CL_COMPLETE or a
+ * negative error code if the command failed
+ *
+ */
+using EventCallback = std::function<void(cl_int status)>;
+
+/**
+ * @brief Runs event callbacks on a thread owned by the library. The OpenCL
+ * runtime calls its callbacks on driver threads, where blocking or calling
+ * back into OpenCL is not allowed, so they are only queued here and run on
+ * the dispatcher thread
+ *
+ */
+class EventDispatcher {
+  public:
+    EventDispatcher() = default;
+    ~EventDispatcher();
+    EventDispatcher(const EventDispatcher &) = delete;
+    EventDispatcher &operator=(const EventDispatcher &) = delete;
+
+    /**
+     * @brief Call callback on the dispatcher thread once event completes
+     *
+     * @param event Event to watch
+     * @param callback Called with the execution status of the event
+     * @return int
+     */
+    int Watch(cl::Event event, EventCallback callback);
+
+    /**
+     * @brief Run task on the dispatcher thread
+     *
+     * @param task
+     */
+    void Post(std::function<void()> task);
+
+    /**
+     * @brief Wait for all watched events and stop the thread
+     *
+     */
+    void Stop();
+
+  private:
+    static void CL_CALLBACK _OnComplete(cl_event event, cl_int status,
+                                        void *userData);
+    void _Start();
+    void _Run();
+
+    std::thread _thread;
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::deque<std::function<void()>> _tasks;
+    size_t _watched = 0;
+    bool _stopping = false;
+};
+
+} // namespace peasyocl
+
+#endif
@@ -0,0 +1,270 @@
+// Copyright 2024 viktorlanner
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "FileStream.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace peasyocl {
+
+#ifdef _WIN32
+
+int MappedFile::Open(const std::string &path) {
+    Close();
+
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                              nullptr, OPEN_EXISTING,
+                              FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        printf("Error: Failed to open file %s!\n", path.c_str());
+        return 1;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        printf("Error: Failed to map empty file %s!\n", path.c_str());
+        CloseHandle(file);
+        return 1;
+    }
+
+    HANDLE mapping =
+        CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    void *data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)
+                         : nullptr;
+    if (!data) {
+        printf("Error: Failed to map file %s!\n", path.c_str());
+        if (mapping) {
+            CloseHandle(mapping);
+        }
+        CloseHandle(file);
+        return 1;
+    }
+
+    _file = file;
+    _mapping = mapping;
+    _data = static_cast<const unsigned char *>(data);
+    _size = static_cast<size_t>(size.QuadPart);
+    return 0;
+}
+
+void MappedFile::Close() {
+    if (_data) {
+        UnmapViewOfFile(_data);
+        CloseHandle(_mapping);
+        CloseHandle(_file);
+    }
+    _data = nullptr;
+    _size = 0;
+}
+
+void MappedFile::Prefetch(const size_t &offset, const size_t &size) {}
+
+void MappedFile::Release(const size_t &offset, const size_t &size) {}
+
+#else
+
+static void PageRange(const size_t &offset, const size_t &size,
+                      const size_t &fileSize, size_t *begin, size_t *length) {
+    static const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    *begin = offset - offset % page;
+    *length = std::min(offset + size, fileSize) - *begin;
+}
+
+int MappedFile::Open(const std::string &path) {
+    Close();
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        printf("Error: Failed to open file %s!\n", path.c_str());
+        return 1;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        printf("Error: Failed to map empty file %s!\n", path.c_str());
+        close(fd);
+        return 1;
+    }
+
+    size_t size = static_cast<size_t>(info.st_size);
+    void *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        printf("Error: Failed to map file %s!\n", path.c_str());
+        close(fd);
+        return 1;
+    }
+    madvise(data, size, MADV_SEQUENTIAL);
+
+    _fd = fd;
+    _data = static_cast<const unsigned char *>(data);
+    _size = size;
+    return 0;
+}
+
+void MappedFile::Close() {
+    if (_data) {
+        munmap(const_cast<unsigned char *>(_data), _size);
+        close(_fd);
+    }
+    _data = nullptr;
+    _size = 0;
+    _fd = -1;
+}
+
+void MappedFile::Prefetch(const size_t &offset, const size_t &size) {
+    if (!_data || offset >= _size) {
+        return;
+    }
+    size_t begin, length;
+    PageRange(offset, size, _size, &begin, &length);
+    madvise(const_cast<unsigned char *>(_data) + begin, length, MADV_WILLNEED);
+}
+
+void MappedFile::Release(const size_t &offset, const size_t &size) {
+    if (!_data || offset >= _size) {
+        return;
+    }
+    size_t begin, length;
+    PageRange(offset, size, _size, &begin, &length);
+    madvise(const_cast<unsigned char *>(_data) + begin, length, MADV_DONTNEED);
+}
+
+#endif
+
+namespace utils {
+
+int StreamFile(const cl::Context &context, const cl::CommandQueue &queue,
+               const std::string &path, const cl::Buffer &buffer,
+               const size_t &bufferOffset, const size_t &fileOffset,
+               const size_t &size, const size_t &chunkSize,
+               std::vector<std::pair<cl::Event, size_t>> *writes) {
+    MappedFile file;
+    if (file.Open(path) != 0) {
+        return 1;
+    }
+    return StreamFile(context, queue, file, buffer, bufferOffset, fileOffset,
+                      size, chunkSize, writes);
+}
+
+int StreamFile(const cl::Context &context, const cl::CommandQueue &queue,
+               MappedFile &file, const cl::Buffer &buffer,
+               const size_t &bufferOffset, const size_t &fileOffset,
+               const size_t &size, const size_t &chunkSize,
+               std::vector<std::pair<cl::Event, size_t>> *writes) {
+    if (!file.IsOpen()) {
+        printf("Error: Failed to stream, file is not open!\n");
+        return 1;
+    }
+    if (fileOffset >= file.Size()) {
+        printf("Error: Offset %zu is past the end of the file!\n", fileOffset);
+        return 1;
+    }
+
+    size_t total = size > 0 ? size : file.Size() - fileOffset;
+    if (fileOffset + total > file.Size()) {
+        printf("Error: Range is past the end of the file!\n");
+        return 1;
+    }
+    size_t chunk = std::min(chunkSize > 0 ? chunkSize : DefaultStreamChunkSize,
+                            total);
+
+    // Two pinned staging areas. The mapped pointers are used as the source of
+    // the writes, which lets the driver DMA from them directly
+    cl_int err;
+    cl::Buffer staging[2];
+    unsigned char *pinned[2] = {nullptr, nullptr};
+    cl::Event written[2];
+    bool pending[2] = {false, false};
+
+    auto unmap = [&]() {
+        cl::vector<cl::Event> unmapped;
+        for (int i = 0; i < 2; i++) {
+            if (pending[i]) {
+                written[i].wait();
+            }
+            if (pinned[i]) {
+                unmapped.emplace_back();
+                queue.enqueueUnmapMemObject(staging[i], pinned[i], nullptr,
+                                            &unmapped.back());
+            }
+        }
+        if (!unmapped.empty()) {
+            cl::WaitForEvents(unmapped);
+        }
+    };
+
+    for (int i = 0; i < 2; i++) {
+        staging[i] = cl::Buffer(context, CL_MEM_ALLOC_HOST_PTR | CL_MEM_READ_ONLY,
+                                chunk, nullptr, &err);
+        if (err != CL_SUCCESS) {
+            printf("Error: Failed to create staging buffer! %i\n", err);
+            unmap();
+            return 1;
+        }
+        pinned[i] = static_cast<unsigned char *>(queue.enqueueMapBuffer(
+            staging[i], CL_TRUE, CL_MAP_WRITE, 0, chunk, nullptr, nullptr,
+            &err));
+        if (err != CL_SUCCESS) {
+            printf("Error: Failed to map staging buffer! %i\n", err);
+            pinned[i] = nullptr;
+            unmap();
+            return 1;
+        }
+    }
+
+    int result = 0;
+    file.Prefetch(fileOffset, chunk);
+    for (size_t done = 0, slot = 0; done < total; done += chunk, slot ^= 1) {
+        size_t count = std::min(chunk, total - done);
+        size_t offset = fileOffset + done;
+        file.Prefetch(offset + count, chunk);
+
+        if (pending[slot]) {
+            written[slot].wait();
+        }
+        std::memcpy(pinned[slot], file.Data() + offset, count);
+        file.Release(offset, count);
+
+        err = queue.enqueueWriteBuffer(buffer, CL_FALSE, bufferOffset + done,
+                                       count, pinned[slot], nullptr,
+                                       &written[slot]);
+        if (err != CL_SUCCESS) {
+            printf("Error: Failed to stream file to buffer! %i\n", err);
+            result = 1;
+            break;
+        }
+        pending[slot] = true;
+        if (writes) {
+            writes->emplace_back(written[slot], count);
+        }
+        queue.flush();
+    }
+
+    unmap();
+    return result;
+}
+
+} // namespace utils
+
+} // namespace peasyocl
@@ -0,0 +1,115 @@
+// Copyright 2024 viktorlanner
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef OCL_FILE_STREAM_H
+#define OCL_FILE_STREAM_H
+
+#include "Types.h"
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace peasyocl {
+
+/**
+ * @brief Read only memory mapping of a file
+ *
+ */
+class MappedFile {
+  public:
+    MappedFile() = default;
+    ~MappedFile() { Close(); }
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    int Open(const std::string &path);
+    void Close();
+
+    /**
+     * @brief Hint that a range will be read soon, so the OS can start
+     * reading it from disk
+     *
+     * @param offset Offset in bytes
+     * @param size Size in bytes
+     */
+    void Prefetch(const size_t &offset, const size_t &size);
+
+    /**
+     * @brief Drop a range that has been consumed from the page cache of this
+     * mapping, so it does not stay resident
+     *
+     * @param offset Offset in bytes
+     * @param size Size in bytes
+     */
+    void Release(const size_t &offset, const size_t &size);
+
+    const unsigned char *Data() const { return _data; }
+    size_t Size() const { return _size; }
+    bool IsOpen() const { return _data != nullptr; }
+
+  private:
+    const unsigned char *_data = nullptr;
+    size_t _size = 0;
+#ifdef _WIN32
+    void *_file = nullptr;
+    void *_mapping = nullptr;
+#else
+    int _fd = -1;
+#endif
+};
+
+namespace utils {
+
+constexpr size_t DefaultStreamChunkSize = 8 * 1024 * 1024;
+
+/**
+ * @brief Stream a range of a file into buffer. The file is memory mapped and
+ * copied chunk by chunk into two pinned staging areas, so reading the next
+ * chunk from disk overlaps the transfer of the previous one. Consumed chunks
+ * are released, so the file is never fully resident in host memory
+ *
+ * @param context Context to create the staging buffers in
+ * @param queue Queue to transfer on
+ * @param path Path of the file
+ * @param buffer Buffer to write to
+ * @param bufferOffset Offset in bytes into buffer
+ * @param fileOffset Offset in bytes into the file
+ * @param size Bytes to stream. 0 streams to the end of the file
+ * @param chunkSize Size of each staging area in bytes
+ * @param writes Receives the event and size in bytes of every chunk written
+ * @return int
+ */
+int StreamFile(const cl::Context &context, const cl::CommandQueue &queue,
+               const std::string &path, const cl::Buffer &buffer,
+               const size_t &bufferOffset, const size_t &fileOffset,
+               const size_t &size,
+               const size_t &chunkSize = DefaultStreamChunkSize,
+               std::vector<std::pair<cl::Event, size_t>> *writes = nullptr);
+
+/**
+ * @brief Stream a range of an already opened file into buffer
+ *
+ */
+int StreamFile(const cl::Context &context, const cl::CommandQueue &queue,
+               MappedFile &file, const cl::Buffer &buffer,
+               const size_t &bufferOffset, const size_t &fileOffset,
+               const size_t &size,
+               const size_t &chunkSize = DefaultStreamChunkSize,
+               std::vector<std::pair<cl::Event, size_t>> *writes = nullptr);
+
+} // namespace utils
+
+} // namespace peasyocl
+
+#endif
@@ -0,0 +1,92 @@
+// Copyright 2024 viktorlanner
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "HostCounters.h"
+
+#include <cstdio>
+
+namespace peasyocl {
+
+void HostCounters::Add(const HostStage &stage, const uint64_t &nanoseconds) {
+    Counter &counter = _counters[static_cast<int>(stage)];
+    counter.calls.fetch_add(1, std::memory_order_relaxed);
+    counter.total.fetch_add(nanoseconds, std::memory_order_relaxed);
+    uint64_t max = counter.max.load(std::memory_order_relaxed);
+    while (nanoseconds > max &&
+           !counter.max.compare_exchange_weak(max, nanoseconds,
+                                              std::memory_order_relaxed)) {
+    }
+}
+
+StageStats HostCounters::Get(const HostStage &stage) const {
+    const Counter &counter = _counters[static_cast<int>(stage)];
+    StageStats stats;
+    stats.calls = counter.calls.load(std::memory_order_relaxed);
+    stats.total = counter.total.load(std::memory_order_relaxed);
+    stats.max = counter.max.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void HostCounters::Reset() {
+    for (Counter &counter : _counters) {
+        counter.calls.store(0, std::memory_order_relaxed);
+        counter.total.store(0, std::memory_order_relaxed);
+        counter.max.store(0, std::memory_order_relaxed);
+    }
+}
+
+void HostCounters::Print() const {
+    if (!Enabled()) {
+        printf("Host counters are disabled, build with "
+               "PEASYOCL_HOST_COUNTERS=ON\n");
+        return;
+    }
+    printf("%-14s %10s %12s %10s\n", "Stage", "Calls", "Mean (ns)",
+           "Max (ns)");
+    for (int i = 0; i < static_cast<int>(HostStage::Count); i++) {
+        HostStage stage = static_cast<HostStage>(i);
+        StageStats stats = Get(stage);
+        printf("%-14s %10llu %12.0f %10llu\n", StageName(stage),
+               static_cast<unsigned long long>(stats.calls), stats.Mean(),
+               static_cast<unsigned long long>(stats.max));
+    }
+}
+
+const char *HostCounters::StageName(const HostStage &stage) {
+    switch (stage) {
+    case HostStage::Execute:
+        return "Execute";
+    case HostStage::KernelLookup:
+        return "KernelLookup";
+    case HostStage::BufferLookup:
+        return "BufferLookup";
+    case HostStage::WorkGroupInfo:
+        return "WorkGroupInfo";
+    case HostStage::Bind:
+        return "Bind";
+    case HostStage::MirrorSync:
+        return "MirrorSync";
+    case HostStage::Enqueue:
+        return "Enqueue";
+    case HostStage::Wait:
+        return "Wait";
+    case HostStage::SetArgument:
+        return "SetArgument";
+    default:
+        return "Unknown";
+    }
+}
+
+} // namespace peasyocl
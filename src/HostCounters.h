@@ -0,0 +1,126 @@
+// Copyright 2024 viktorlanner
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef OCL_HOST_COUNTERS_H
+#define OCL_HOST_COUNTERS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace peasyocl {
+
+/**
+ * @brief Host side stages of the dispatch path
+ *
+ */
+enum class HostStage {
+    Execute,       // Whole Execute call
+    KernelLookup,  // Kernel handle lookup by name
+    BufferLookup,  // Buffer lookup by name
+    WorkGroupInfo, // Kernel resource queries after a build
+    Bind,          // Restoring and rebinding buffer arguments
+    MirrorSync,    // Uploading dirty mirror pages
+    Enqueue,       // enqueueNDRangeKernel
+    Wait,          // Waiting for the kernel to complete
+    SetArgument,   // setArg calls
+    Count
+};
+
+/**
+ * @brief Number of calls and host nanoseconds spent in one stage
+ *
+ */
+struct StageStats {
+    uint64_t calls = 0;
+    uint64_t total = 0;
+    uint64_t max = 0;
+
+    double Mean() const { return calls > 0 ? double(total) / calls : 0.0; }
+};
+
+/**
+ * @brief Lock free per stage counters of host time. Only filled when the
+ * library is built with PEASYOCL_HOST_COUNTERS, otherwise the scopes compile
+ * to nothing
+ *
+ */
+class HostCounters {
+  public:
+    void Add(const HostStage &stage, const uint64_t &nanoseconds);
+    StageStats Get(const HostStage &stage) const;
+    void Reset();
+    void Print() const;
+
+    static const char *StageName(const HostStage &stage);
+
+    static constexpr bool Enabled() {
+#ifdef PEASYOCL_HOST_COUNTERS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+  private:
+    struct Counter {
+        std::atomic<uint64_t> calls{0};
+        std::atomic<uint64_t> total{0};
+        std::atomic<uint64_t> max{0};
+    };
+
+    Counter _counters[static_cast<int>(HostStage::Count)];
+};
+
+/**
+ * @brief Adds the time from construction to destruction to a stage
+ *
+ */
+class HostStageScope {
+  public:
+    HostStageScope(HostCounters &counters, const HostStage &stage)
+        : _counters(counters), _stage(stage),
+          _start(std::chrono::steady_clock::now()) {}
+
+    ~HostStageScope() {
+        _counters.Add(_stage,
+                      std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          std::chrono::steady_clock::now() - _start)
+                          .count());
+    }
+
+    HostStageScope(const HostStageScope &) = delete;
+    HostStageScope &operator=(const HostStageScope &) = delete;
+
+  private:
+    HostCounters &_counters;
+    HostStage _stage;
+    std::chrono::steady_clock::time_point _start;
+};
+
+} // namespace peasyocl
+
+#define PEASYOCL_CONCAT_IMPL(a, b) a##b
+#define PEASYOCL_CONCAT(a, b) PEASYOCL_CONCAT_IMPL(a, b)
+
+#ifdef PEASYOCL_HOST_COUNTERS
+#define PEASYOCL_HOST_STAGE(counters, stage)                                   \
+    peasyocl::HostStageScope PEASYOCL_CONCAT(_hostStage, __LINE__)(            \
+        counters, peasyocl::HostStage::stage)
+#else
+#define PEASYOCL_HOST_STAGE(counters, stage)
+#endif
+
+#endif
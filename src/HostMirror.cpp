@@ -0,0 +1,150 @@
+// Copyright 2024 viktorlanner
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "HostMirror.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace peasyocl {
+
+static constexpr size_t NoPage = std::numeric_limits<size_t>::max();
+
+HostMirror::HostMirror(SharedBuffer buffer, const size_t &size,
+                       const size_t &pageSize)
+    : _buffer(std::move(buffer)), _data(size),
+      _pageSize(pageSize > 0 ? pageSize : DefaultPageSize),
+      _firstDirty(NoPage), _lastDirty(0) {
+    _dirty.resize((size + _pageSize - 1) / _pageSize, false);
+}
+
+int HostMirror::Write(const void *data, const size_t &offset,
+                      const size_t &size) {
+    if (offset + size > _data.size()) {
+        printf("Error: Mirror write of %zu bytes at %zu is out of range!\n",
+               size, offset);
+        return 1;
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    _WaitPending();
+    std::memcpy(_data.data() + offset, data, size);
+    _MarkDirty(offset, size);
+    return 0;
+}
+
+void HostMirror::MarkDirty(const size_t &offset, const size_t &size) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _MarkDirty(offset, size);
+}
+
+void HostMirror::_MarkDirty(const size_t &offset, const size_t &size) {
+    if (size == 0 || offset >= _data.size()) {
+        return;
+    }
+    size_t first = offset / _pageSize;
+    size_t last = std::min(offset + size, _data.size()) - 1;
+    last /= _pageSize;
+
+    for (size_t page = first; page <= last; page++) {
+        _dirty[page] = true;
+    }
+    _firstDirty = std::min(_firstDirty, first);
+    _lastDirty = std::max(_lastDirty, last);
+}
+
+std::vector<std::pair<size_t, size_t>> HostMirror::DirtyRanges() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _DirtyRanges();
+}
+
+std::vector<std::pair<size_t, size_t>> HostMirror::_DirtyRanges() const {
+    std::vector<std::pair<size_t, size_t>> ranges;
+    if (!_IsDirty()) {
+        return ranges;
+    }
+
+    size_t page = _firstDirty;
+    while (page <= _lastDirty) {
+        if (!_dirty[page]) {
+            page++;
+            continue;
+        }
+        size_t begin = page;
+        while (page <= _lastDirty && _dirty[page]) {
+            page++;
+        }
+        size_t offset = begin * _pageSize;
+        size_t end = std::min(page * _pageSize, _data.size());
+        ranges.push_back({offset, end - offset});
+    }
+    return ranges;
+}
+
+int HostMirror::Sync(cl::CommandQueue &queue, std::vector<cl::Event> *events,
+                     std::vector<std::pair<size_t, size_t>> *ranges) {
+    return Sync(queue, *_buffer, events, ranges);
+}
+
+int HostMirror::Sync(cl::CommandQueue &queue, const cl::Buffer &target,
+                     std::vector<cl::Event> *events,
+                     std::vector<std::pair<size_t, size_t>> *ranges) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_IsDirty()) {
+        return 0;
+    }
+
+    // The queue is in-order, so only the last write needs to be waited on
+    // before the host copy can be modified again.
+    cl_int err = CL_SUCCESS;
+    for (auto &[offset, size] : _DirtyRanges()) {
+        err = queue.enqueueWriteBuffer(target, CL_FALSE, offset, size,
+                                       _data.data() + offset, nullptr,
+                                       &_pending);
+        if (err != CL_SUCCESS) {
+            printf("Error: Failed to write mirror range to buffer! %i\n",
+                   err);
+            return 1;
+        }
+        _hasPending = true;
+        if (events) {
+            events->push_back(_pending);
+        }
+        if (ranges) {
+            ranges->push_back({offset, size});
+        }
+    }
+
+    std::fill(_dirty.begin() + _firstDirty, _dirty.begin() + _lastDirty + 1,
+              false);
+    _firstDirty = NoPage;
+    _lastDirty = 0;
+    return 0;
+}
+
+void *HostMirror::Data() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _WaitPending();
+    return _data.data();
+}
+
+void HostMirror::_WaitPending() {
+    if (!_hasPending) {
+        return;
+    }
+    _pending.wait();
+    _hasPending = false;
+}
+
+} // namespace peasyocl
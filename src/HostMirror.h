@@ -0,0 +1,136 @@
+// Copyright 2024 viktorlanner
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef OCL_HOST_MIRROR_H
+#define OCL_HOST_MIRROR_H
+
+#include "Types.h"
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace peasyocl {
+
+/**
+ * @brief Host side copy of a device buffer. Writes go to the host copy and
+ * mark the touched pages as dirty. Sync uploads only the dirty pages, merged
+ * into contiguous ranges. Write, MarkDirty and Sync can be called from
+ * several threads, but writes through Data() must not overlap a Sync
+ *
+ */
+class HostMirror {
+  public:
+    static constexpr size_t DefaultPageSize = 4096;
+
+    /**
+     * @brief Construct a mirror of buffer
+     *
+     * @param buffer Device buffer to mirror
+     * @param size Size of the buffer in bytes
+     * @param pageSize Granularity of the dirty tracking in bytes
+     */
+    HostMirror(SharedBuffer buffer, const size_t &size,
+               const size_t &pageSize = DefaultPageSize);
+
+    /**
+     * @brief Copy data into the mirror and mark the touched pages dirty
+     *
+     * @param data Data to copy
+     * @param offset Offset in bytes into the mirror
+     * @param size Size in bytes to copy
+     * @return int
+     */
+    int Write(const void *data, const size_t &offset, const size_t &size);
+
+    /**
+     * @brief Mark a range as dirty. Use after writing through Data()
+     *
+     * @param offset Offset in bytes
+     * @param size Size in bytes
+     */
+    void MarkDirty(const size_t &offset, const size_t &size);
+
+    /**
+     * @brief Get the dirty pages merged into (offset, size) byte ranges
+     *
+     * @return std::vector<std::pair<size_t, size_t>>
+     */
+    std::vector<std::pair<size_t, size_t>> DirtyRanges() const;
+
+    /**
+     * @brief Enqueue non-blocking writes for all dirty ranges and clear the
+     * dirty state. The next Write waits for the uploads to finish before
+     * touching the host copy. Writes to the buffer as it is, so sync a
+     * mirror of an evictable buffer through a pin
+     *
+     * @param queue Queue to enqueue the writes on
+     * @param events Optional list to append the event of each write to
+     * @param ranges Optional list to append the range of each write to
+     * @return int
+     */
+    int Sync(cl::CommandQueue &queue, std::vector<cl::Event> *events = nullptr,
+             std::vector<std::pair<size_t, size_t>> *ranges = nullptr);
+
+    /**
+     * @brief Sync into target, the handle of a pin on the mirrored buffer.
+     * Keeps the buffer from being evicted while the writes are enqueued
+     *
+     * @param queue Queue to enqueue the writes on
+     * @param target Current handle of the mirrored buffer
+     * @param events Optional list to append the event of each write to
+     * @param ranges Optional list to append the range of each write to
+     * @return int
+     */
+    int Sync(cl::CommandQueue &queue, const cl::Buffer &target,
+             std::vector<cl::Event> *events = nullptr,
+             std::vector<std::pair<size_t, size_t>> *ranges = nullptr);
+
+    /**
+     * @brief Host copy of the buffer. Wait for pending uploads and call
+     * MarkDirty after writing to it
+     *
+     * @return void*
+     */
+    void *Data();
+
+    bool IsDirty() const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _IsDirty();
+    }
+    size_t Size() const { return _data.size(); }
+    size_t PageSize() const { return _pageSize; }
+    SharedBuffer Buffer() const { return _buffer; }
+
+  private:
+    bool _IsDirty() const { return _firstDirty <= _lastDirty; }
+    void _MarkDirty(const size_t &offset, const size_t &size);
+    std::vector<std::pair<size_t, size_t>> _DirtyRanges() const;
+    void _WaitPending();
+
+    // Guards the host copy, the dirty state and the pending upload
+    mutable std::mutex _mutex;
+
+    SharedBuffer _buffer;
+    std::vector<unsigned char> _data;
+    std::vector<bool> _dirty;
+    size_t _pageSize;
+    size_t _firstDirty;
+    size_t _lastDirty;
+    cl::Event _pending;
+    bool _hasPending = false;
+};
+
+} // namespace peasyocl
+
+#endif
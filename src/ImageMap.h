@@ -0,0 +1,90 @@
+// Copyright 2024 viktorlanner
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef OCL_IMAGE_MAP_H
+#define OCL_IMAGE_MAP_H
+
+#include "ShardedMap.h"
+#include "Types.h"
+#include <atomic>
+#include <string>
+
+namespace peasyocl {
+
+/**
+ * @brief An image stored in the context. 2D images have a depth of 1. Images
+ * are never evicted, but they count against the memory budget and their
+ * allocations can evict unused buffers. Removed with the last kernel bound
+ * to it
+ *
+ */
+struct ImageEntry {
+    std::string name;
+    SharedImage image;
+    cl::ImageFormat format;
+    cl_mem_flags flags = 0;
+    size_t width = 0;
+    size_t height = 0;
+    size_t depth = 1;
+    size_t pixelSize = 0;
+    bool is3D = false;
+    std::atomic<int> users{0};
+
+    /**
+     * @brief The region covering the whole image
+     *
+     * @return cl::array<cl::size_type, 3>
+     */
+    cl::array<cl::size_type, 3> Region() const {
+        return {width, height, depth};
+    }
+
+    size_t Size() const { return width * height * depth * pixelSize; }
+
+    /**
+     * @brief Whether the image has the given format and extent. A depth of 0
+     * stands for a 2D image, as in Context::CreateImage3D
+     *
+     * @return bool
+     */
+    bool Matches(const cl::ImageFormat &other, const size_t &otherWidth,
+                 const size_t &otherHeight, const size_t &otherDepth) const {
+        return format.image_channel_order == other.image_channel_order &&
+               format.image_channel_data_type ==
+                   other.image_channel_data_type &&
+               width == otherWidth && height == otherHeight &&
+               is3D == (otherDepth > 0) &&
+               depth == (otherDepth > 0 ? otherDepth : 1);
+    }
+};
+
+using ImageMap = ShardedMap<std::string, ImageEntry>;
+using SamplerMap = ShardedMap<std::string, cl::Sampler>;
+
+namespace utils {
+
+/**
+ * @brief Bytes per pixel of an image format
+ *
+ * @param format
+ * @return size_t 0 for unknown channel orders or types
+ */
+size_t PixelSize(const cl::ImageFormat &format);
+
+} // namespace utils
+
+} // namespace peasyocl
+
+#endif
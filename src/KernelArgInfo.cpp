@@ -0,0 +1,64 @@
+// Copyright 2024 viktorlanner
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "KernelArgInfo.h"
+
+#include <cstdio>
+
+namespace peasyocl {
+
+namespace utils {
+
+int QueryKernelArgs(const cl::Kernel &kernel, KernelArgList *args) {
+    cl_uint count = 0;
+    cl_int err = kernel.getInfo(CL_KERNEL_NUM_ARGS, &count);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to get kernel argument count! %i\n", err);
+        return 1;
+    }
+
+    KernelArgList result(count);
+    for (cl_uint i = 0; i < count; i++) {
+        KernelArgInfo &arg = result[i];
+        err = kernel.getArgInfo(i, CL_KERNEL_ARG_NAME, &arg.name);
+        err |= kernel.getArgInfo(i, CL_KERNEL_ARG_TYPE_NAME, &arg.typeName);
+        err |= kernel.getArgInfo(i, CL_KERNEL_ARG_ADDRESS_QUALIFIER,
+                                 &arg.address);
+        err |= kernel.getArgInfo(i, CL_KERNEL_ARG_ACCESS_QUALIFIER,
+                                 &arg.access);
+        err |= kernel.getArgInfo(i, CL_KERNEL_ARG_TYPE_QUALIFIER,
+                                 &arg.typeQualifier);
+        if (err != CL_SUCCESS) {
+            printf("Error: Failed to get info of kernel argument %u! Was the "
+                   "program built with -cl-kernel-arg-info?\n",
+                   i);
+            return 1;
+        }
+        // Some implementations count the terminating null in the size
+        while (!arg.name.empty() && arg.name.back() == '\0') {
+            arg.name.pop_back();
+        }
+        while (!arg.typeName.empty() && arg.typeName.back() == '\0') {
+            arg.typeName.pop_back();
+        }
+    }
+
+    *args = std::move(result);
+    return 0;
+}
+
+} // namespace utils
+
+} // namespace peasyocl
@@ -0,0 +1,76 @@
+// Copyright 2024 viktorlanner
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef OCL_KERNEL_ARG_INFO_H
+#define OCL_KERNEL_ARG_INFO_H
+
+#include "Types.h"
+#include <string>
+#include <vector>
+
+namespace peasyocl {
+
+/**
+ * @brief Signature of one kernel parameter from clGetKernelArgInfo. Only
+ * available for programs built with -cl-kernel-arg-info
+ *
+ */
+struct KernelArgInfo {
+    std::string name;
+    std::string typeName;
+    cl_kernel_arg_address_qualifier address = CL_KERNEL_ARG_ADDRESS_PRIVATE;
+    cl_kernel_arg_access_qualifier access = CL_KERNEL_ARG_ACCESS_NONE;
+    cl_kernel_arg_type_qualifier typeQualifier = CL_KERNEL_ARG_TYPE_NONE;
+
+    /**
+     * @brief Whether the parameter takes a memory object
+     *
+     */
+    bool IsBuffer() const {
+        return address == CL_KERNEL_ARG_ADDRESS_GLOBAL ||
+               address == CL_KERNEL_ARG_ADDRESS_CONSTANT;
+    }
+    bool IsLocal() const { return address == CL_KERNEL_ARG_ADDRESS_LOCAL; }
+
+    /**
+     * @brief Whether the kernel only reads the parameter, so it can be left
+     * out of write dependencies
+     *
+     */
+    bool IsReadOnly() const {
+        return address == CL_KERNEL_ARG_ADDRESS_CONSTANT ||
+               (typeQualifier & CL_KERNEL_ARG_TYPE_CONST) != 0 ||
+               access == CL_KERNEL_ARG_ACCESS_READ_ONLY;
+    }
+};
+
+using KernelArgList = std::vector<KernelArgInfo>;
+
+namespace utils {
+
+/**
+ * @brief Query the name, type and qualifiers of every parameter of kernel
+ *
+ * @param kernel Kernel from a program built with -cl-kernel-arg-info
+ * @param args Receives one entry per parameter
+ * @return int
+ */
+int QueryKernelArgs(const cl::Kernel &kernel, KernelArgList *args);
+
+} // namespace utils
+
+} // namespace peasyocl
+
+#endif
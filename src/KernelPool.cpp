@@ -0,0 +1,174 @@
+// Copyright 2024 viktorlanner
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "KernelPool.h"
+
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+
+namespace peasyocl {
+
+namespace utils {
+
+cl_int BindShadowed(cl::Kernel &kernel, ShadowList &shadow, const int index,
+                    const size_t &size, const void *value, size_t *elided) {
+    if (index < 0) {
+        return CL_INVALID_ARG_INDEX;
+    }
+    if (static_cast<size_t>(index) >= shadow.size()) {
+        shadow.resize(index + 1);
+    }
+
+    ArgumentShadow &bound = shadow[index];
+    const unsigned char *bytes = static_cast<const unsigned char *>(value);
+    if (bound.bound && bound.size == size &&
+        bound.null == (bytes == nullptr) &&
+        (bytes == nullptr ||
+         std::memcmp(bound.bytes.data(), bytes, size) == 0)) {
+        if (elided) {
+            (*elided)++;
+        }
+        return CL_SUCCESS;
+    }
+
+    cl_int err = kernel.setArg(index, size, value);
+    if (err != CL_SUCCESS) {
+        bound.bound = false;
+        return err;
+    }
+    bound.bound = true;
+    bound.size = size;
+    bound.null = bytes == nullptr;
+    if (bytes) {
+        bound.bytes.assign(bytes, bytes + size);
+    }
+    return CL_SUCCESS;
+}
+
+} // namespace utils
+
+static uint64_t NextPoolId() {
+    static std::atomic<uint64_t> next{1};
+    return next.fetch_add(1, std::memory_order_relaxed);
+}
+
+KernelPool::KernelPool(const cl::Program &program,
+                       const std::string &kernelName)
+    : _id(NextPoolId()), _program(program), _kernelName(kernelName) {}
+
+/**
+ * @brief The instances of one thread. Returns them to their pools when the
+ * thread exits
+ *
+ */
+struct ThreadInstances {
+    struct Slot {
+        std::weak_ptr<KernelPool> pool;
+        KernelInstance *instance;
+    };
+    std::unordered_map<uint64_t, Slot> slots;
+
+    ~ThreadInstances() {
+        for (auto &[id, slot] : slots) {
+            if (SharedKernelPool pool = slot.pool.lock()) {
+                pool->_Release(slot.instance);
+            }
+        }
+    }
+
+    // Drop the slots of destroyed pools
+    void Prune() {
+        for (auto it = slots.begin(); it != slots.end();) {
+            if (it->second.pool.expired()) {
+                it = slots.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+};
+
+KernelInstance *KernelPool::Local(const ShadowList *initial,
+                                  std::mutex *initialMutex) {
+    thread_local ThreadInstances instances;
+    auto found = instances.slots.find(_id);
+    if (found != instances.slots.end()) {
+        return found->second.instance;
+    }
+
+    KernelInstance *instance = _Create(initial, initialMutex);
+    if (instance) {
+        instances.Prune();
+        instances.slots[_id] = {weak_from_this(), instance};
+    }
+    return instance;
+}
+
+void KernelPool::_Release(KernelInstance *instance) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _free.push_back(instance);
+}
+
+size_t KernelPool::Size() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _instances.size();
+}
+
+KernelInstance *KernelPool::_Create(const ShadowList *initial,
+                                    std::mutex *initialMutex) {
+    KernelInstance *instance = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_free.empty()) {
+            // Its shadow still matches the arguments bound on its kernel
+            instance = _free.back();
+            _free.pop_back();
+            instance->event = cl::Event();
+        }
+    }
+
+    if (!instance) {
+        cl_int err;
+        cl::Kernel kernel(_program, _kernelName.c_str(), &err);
+        if (err != CL_SUCCESS) {
+            printf("Error: Failed to create kernel instance %s! %i\n",
+                   _kernelName.c_str(), err);
+            return nullptr;
+        }
+
+        // Deque elements keep their address when the pool grows
+        std::lock_guard<std::mutex> lock(_mutex);
+        _instances.push_back(KernelInstance{kernel, {}, 0, cl::Event()});
+        instance = &_instances.back();
+    }
+
+    if (initial) {
+        std::unique_lock<std::mutex> copy;
+        if (initialMutex) {
+            copy = std::unique_lock<std::mutex>(*initialMutex);
+        }
+        for (size_t i = 0; i < initial->size(); i++) {
+            const ArgumentShadow &arg = (*initial)[i];
+            if (arg.bound) {
+                instance->BindArgument(static_cast<int>(i), arg.size,
+                                       arg.null ? nullptr : arg.bytes.data());
+            }
+        }
+    }
+    return instance;
+}
+
+} // namespace peasyocl
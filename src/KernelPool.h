@@ -0,0 +1,148 @@
+// Copyright 2024 viktorlanner
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef OCL_KERNEL_POOL_H
+#define OCL_KERNEL_POOL_H
+
+#include "Types.h"
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace peasyocl {
+
+/**
+ * @brief The bytes last bound to a kernel argument, used to skip setArg
+ * calls that would not change anything
+ *
+ */
+struct ArgumentShadow {
+    std::vector<unsigned char> bytes;
+    size_t size = 0;
+    bool bound = false;
+    bool null = false;
+};
+
+using ShadowList = std::vector<ArgumentShadow>;
+
+namespace utils {
+
+/**
+ * @brief Bind size bytes at value to argument index of kernel, unless
+ * exactly those bytes are already bound according to shadow
+ *
+ * @param kernel
+ * @param shadow Shadow state of kernel, updated on success
+ * @param index Argument index
+ * @param size Size in bytes
+ * @param value Bytes to bind, nullptr for __local arguments
+ * @param elided Incremented when the call is skipped
+ * @return cl_int
+ */
+cl_int BindShadowed(cl::Kernel &kernel, ShadowList &shadow, const int index,
+                    const size_t &size, const void *value, size_t *elided);
+
+/**
+ * @brief Forget the bytes bound to argument index, so the next bind calls
+ * setArg even if the bytes are the same. Needed when the object behind a
+ * handle is replaced, as a new object can get the address of a released one
+ *
+ * @param shadow
+ * @param index Argument index
+ */
+inline void InvalidateShadow(ShadowList &shadow, const int index) {
+    if (index >= 0 && static_cast<size_t>(index) < shadow.size()) {
+        shadow[index].bound = false;
+    }
+}
+
+} // namespace utils
+
+/**
+ * @brief A kernel object owned by one host thread, with its own arguments
+ *
+ */
+struct KernelInstance {
+    cl::Kernel kernel;
+    ShadowList shadow;
+    size_t elidedCalls = 0;
+    // Last launch through this instance
+    cl::Event event;
+    // KernelHandle::rebinds when the buffers were last copied from the handle
+    unsigned rebinds = 0;
+
+    cl_int BindArgument(const int index, const size_t &size,
+                        const void *value) {
+        return utils::BindShadowed(kernel, shadow, index, size, value,
+                                   &elidedCalls);
+    }
+};
+
+/**
+ * @brief Kernel objects of one kernel, one per host thread. setArg followed
+ * by an enqueue is not thread safe on a shared cl::Kernel, so each thread
+ * launches through its own instance. Instances are created from the shared
+ * program with clCreateKernel, as clCloneKernel needs OpenCL 2.1. Only the
+ * first use on a thread takes the pool's lock. When a thread exits its
+ * instances go back to their pools and are handed to the next new thread, so
+ * a pool holds at most one instance per thread running at once. Must be
+ * owned by a shared_ptr
+ *
+ */
+class KernelPool : public std::enable_shared_from_this<KernelPool> {
+  public:
+    KernelPool(const cl::Program &program, const std::string &kernelName);
+    KernelPool(const KernelPool &) = delete;
+    KernelPool &operator=(const KernelPool &) = delete;
+
+    /**
+     * @brief Get the instance of the calling thread. On first use it takes
+     * an instance left by an exited thread or creates one, and binds the
+     * arguments in initial to it
+     *
+     * @param initial Arguments to copy into a new instance
+     * @param initialMutex Held while initial is copied, if set
+     * @return KernelInstance* nullptr if the kernel could not be created
+     */
+    KernelInstance *Local(const ShadowList *initial = nullptr,
+                          std::mutex *initialMutex = nullptr);
+    size_t Size() const;
+
+  private:
+    friend struct ThreadInstances;
+
+    KernelInstance *_Create(const ShadowList *initial,
+                            std::mutex *initialMutex);
+    void _Release(KernelInstance *instance);
+
+    // Never reused, so thread local entries of destroyed pools never match
+    const uint64_t _id;
+    cl::Program _program;
+    std::string _kernelName;
+    mutable std::mutex _mutex;
+    std::deque<KernelInstance> _instances;
+    // Instances of exited threads
+    std::vector<KernelInstance *> _free;
+};
+
+using SharedKernelPool = std::shared_ptr<KernelPool>;
+
+} // namespace peasyocl
+
+#endif
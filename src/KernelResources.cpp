@@ -0,0 +1,88 @@
+// Copyright 2024 viktorlanner
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "KernelResources.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace peasyocl {
+
+namespace utils {
+
+static void EstimateOccupancy(KernelResources &r) {
+    r.occupancy = 0.0;
+    r.localMemoryLimited = false;
+    if (r.deviceMaxWorkGroupSize == 0) {
+        return;
+    }
+    double capacity = double(r.deviceMaxWorkGroupSize);
+    double resident = double(r.workGroupSize);
+    if (r.localMemSize > 0) {
+        // Work groups that fit a compute unit's local memory at once
+        cl_ulong groups = r.deviceLocalMemSize / r.localMemSize;
+        double byLocal = double(groups) * r.workGroupSize;
+        r.localMemoryLimited = byLocal < capacity;
+        resident = std::min(resident, byLocal);
+    }
+    r.occupancy = std::min(resident, capacity) / capacity;
+}
+
+int QueryKernelResources(const cl::Kernel &kernel, const cl::Device &device,
+                         KernelResources *resources) {
+    KernelResources r;
+    cl_int err = kernel.getWorkGroupInfo(device, CL_KERNEL_WORK_GROUP_SIZE,
+                                         &r.workGroupSize);
+    err |= kernel.getWorkGroupInfo(
+        device, CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE,
+        &r.preferredMultiple);
+    err |= kernel.getWorkGroupInfo(device, CL_KERNEL_PRIVATE_MEM_SIZE,
+                                   &r.privateMemSize);
+    err |= kernel.getWorkGroupInfo(device, CL_KERNEL_LOCAL_MEM_SIZE,
+                                   &r.localMemSize);
+    err |= device.getInfo(CL_DEVICE_MAX_WORK_GROUP_SIZE,
+                          &r.deviceMaxWorkGroupSize);
+    err |= device.getInfo(CL_DEVICE_LOCAL_MEM_SIZE, &r.deviceLocalMemSize);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to retrieve kernel work group info! %d\n", err);
+        return 1;
+    }
+
+    r.usesPrivateMemory = r.privateMemSize > 0;
+    r.belowDeviceWorkGroupSize = r.workGroupSize < r.deviceMaxWorkGroupSize;
+    EstimateOccupancy(r);
+
+    *resources = r;
+    return 0;
+}
+
+int QueryKernelLocalMemory(const cl::Kernel &kernel, const cl::Device &device,
+                           KernelResources *resources) {
+    cl_ulong localMemSize = 0;
+    cl_int err = kernel.getWorkGroupInfo(device, CL_KERNEL_LOCAL_MEM_SIZE,
+                                         &localMemSize);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to retrieve kernel local memory size! %d\n",
+               err);
+        return 1;
+    }
+    resources->localMemSize = localMemSize;
+    EstimateOccupancy(*resources);
+    return 0;
+}
+
+} // namespace utils
+
+} // namespace peasyocl
@@ -0,0 +1,85 @@
+// Copyright 2024 viktorlanner
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef OCL_KERNEL_RESOURCES_H
+#define OCL_KERNEL_RESOURCES_H
+
+#include "Types.h"
+
+namespace peasyocl {
+
+/**
+ * @brief Resource usage of a built kernel from clGetKernelWorkGroupInfo and
+ * the limits of its device. Sizes are in bytes. The local memory size
+ * includes the __local arguments bound when it was last queried
+ *
+ */
+struct KernelResources {
+    size_t workGroupSize = 0;
+    size_t preferredMultiple = 0;
+    cl_ulong privateMemSize = 0;
+    cl_ulong localMemSize = 0;
+
+    size_t deviceMaxWorkGroupSize = 0;
+    cl_ulong deviceLocalMemSize = 0;
+
+    /**
+     * @brief Heuristic estimate of the fraction of a compute unit's work
+     * items the kernel can keep resident, from the work group size and local
+     * memory alone. OpenCL 1.2 exposes no register counts or spills
+     *
+     */
+    double occupancy = 0.0;
+    // CL_KERNEL_PRIVATE_MEM_SIZE is not 0. Private arrays count as well as
+    // spilled registers
+    bool usesPrivateMemory = false;
+    // CL_KERNEL_WORK_GROUP_SIZE is below the device maximum, which often
+    // but not always means register pressure
+    bool belowDeviceWorkGroupSize = false;
+    // Heuristic: fewer work groups fit the device's local memory than its
+    // maximum work group size would allow
+    bool localMemoryLimited = false;
+};
+
+namespace utils {
+
+/**
+ * @brief Query the resources of kernel on device and estimate its occupancy
+ *
+ * @param kernel Built kernel
+ * @param device Device the kernel was built for
+ * @param resources Receives the resources
+ * @return int
+ */
+int QueryKernelResources(const cl::Kernel &kernel, const cl::Device &device,
+                         KernelResources *resources);
+
+/**
+ * @brief Query the local memory size again, e.g. after __local arguments were
+ * bound, and update the occupancy estimate
+ *
+ * @param kernel Built kernel
+ * @param device Device the kernel was built for
+ * @param resources Resources from QueryKernelResources
+ * @return int
+ */
+int QueryKernelLocalMemory(const cl::Kernel &kernel, const cl::Device &device,
+                           KernelResources *resources);
+
+} // namespace utils
+
+} // namespace peasyocl
+
+#endif
@@ -0,0 +1,166 @@
+// Copyright 2024 viktorlanner
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef OCL_LAYOUT_H
+#define OCL_LAYOUT_H
+
+#include <cstddef>
+
+#if defined(__SSE2__) || defined(_M_X64) ||                                  \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OCL_LAYOUT_SSE
+#include <emmintrin.h>
+#endif
+
+namespace peasyocl::utils {
+
+/**
+ * @brief Repack count float3 elements into float4 elements with w set to 0
+ *
+ * @param src count * 3 floats
+ * @param dst count * 4 floats
+ * @param count Number of elements
+ */
+inline void PackFloat3ToFloat4(const float *src, float *dst,
+                               const size_t &count) {
+    size_t i = 0;
+#ifdef OCL_LAYOUT_SSE
+    // Each load reads the first float of the next element, so the last
+    // element is done in the scalar loop
+    const __m128 mask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+    for (; i + 1 < count; i++) {
+        __m128 v = _mm_loadu_ps(src + i * 3);
+        _mm_storeu_ps(dst + i * 4, _mm_and_ps(v, mask));
+    }
+#endif
+    for (; i < count; i++) {
+        dst[i * 4 + 0] = src[i * 3 + 0];
+        dst[i * 4 + 1] = src[i * 3 + 1];
+        dst[i * 4 + 2] = src[i * 3 + 2];
+        dst[i * 4 + 3] = 0.0f;
+    }
+}
+
+/**
+ * @brief Repack count float4 elements into float3 elements, dropping w
+ *
+ * @param src count * 4 floats
+ * @param dst count * 3 floats
+ * @param count Number of elements
+ */
+inline void UnpackFloat4ToFloat3(const float *src, float *dst,
+                                 const size_t &count) {
+    size_t i = 0;
+#ifdef OCL_LAYOUT_SSE
+    // Each store writes one float past the element, which the next store
+    // overwrites. The last element is done in the scalar loop
+    for (; i + 1 < count; i++) {
+        _mm_storeu_ps(dst + i * 3, _mm_loadu_ps(src + i * 4));
+    }
+#endif
+    for (; i < count; i++) {
+        dst[i * 3 + 0] = src[i * 4 + 0];
+        dst[i * 3 + 1] = src[i * 4 + 1];
+        dst[i * 3 + 2] = src[i * 4 + 2];
+    }
+}
+
+/**
+ * @brief Split count interleaved elements into one plane per component
+ *
+ * @param src count * components floats, interleaved
+ * @param dst components planes of count floats
+ * @param count Number of elements
+ * @param components Floats per element
+ */
+inline void AosToSoa(const float *src, float *dst, const size_t &count,
+                     const size_t &components) {
+    size_t i = 0;
+#ifdef OCL_LAYOUT_SSE
+    if (components == 3) {
+        float *x = dst;
+        float *y = dst + count;
+        float *z = dst + count * 2;
+        for (; i + 4 <= count; i += 4) {
+            __m128 a = _mm_loadu_ps(src + i * 3);
+            __m128 b = _mm_loadu_ps(src + i * 3 + 4);
+            __m128 c = _mm_loadu_ps(src + i * 3 + 8);
+
+            __m128 t = _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2));
+            _mm_storeu_ps(x + i, _mm_shuffle_ps(a, t, _MM_SHUFFLE(2, 0, 3, 0)));
+
+            t = _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1));
+            __m128 u = _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3));
+            _mm_storeu_ps(y + i, _mm_shuffle_ps(t, u, _MM_SHUFFLE(2, 0, 2, 0)));
+
+            t = _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2));
+            _mm_storeu_ps(z + i, _mm_shuffle_ps(t, c, _MM_SHUFFLE(3, 0, 2, 0)));
+        }
+    }
+#endif
+    for (; i < count; i++) {
+        for (size_t c = 0; c < components; c++) {
+            dst[c * count + i] = src[i * components + c];
+        }
+    }
+}
+
+/**
+ * @brief Interleave one plane per component into count elements
+ *
+ * @param src components planes of count floats
+ * @param dst count * components floats, interleaved
+ * @param count Number of elements
+ * @param components Floats per element
+ */
+inline void SoaToAos(const float *src, float *dst, const size_t &count,
+                     const size_t &components) {
+    size_t i = 0;
+#ifdef OCL_LAYOUT_SSE
+    if (components == 3) {
+        const float *x = src;
+        const float *y = src + count;
+        const float *z = src + count * 2;
+        for (; i + 4 <= count; i += 4) {
+            __m128 vx = _mm_loadu_ps(x + i);
+            __m128 vy = _mm_loadu_ps(y + i);
+            __m128 vz = _mm_loadu_ps(z + i);
+
+            __m128 t = _mm_shuffle_ps(vx, vy, _MM_SHUFFLE(0, 0, 0, 0));
+            __m128 u = _mm_shuffle_ps(vz, vx, _MM_SHUFFLE(1, 1, 0, 0));
+            _mm_storeu_ps(dst + i * 3,
+                          _mm_shuffle_ps(t, u, _MM_SHUFFLE(2, 0, 2, 0)));
+
+            t = _mm_shuffle_ps(vy, vz, _MM_SHUFFLE(1, 1, 1, 1));
+            u = _mm_shuffle_ps(vx, vy, _MM_SHUFFLE(2, 2, 2, 2));
+            _mm_storeu_ps(dst + i * 3 + 4,
+                          _mm_shuffle_ps(t, u, _MM_SHUFFLE(2, 0, 2, 0)));
+
+            t = _mm_shuffle_ps(vz, vx, _MM_SHUFFLE(3, 3, 2, 2));
+            u = _mm_shuffle_ps(vy, vz, _MM_SHUFFLE(3, 3, 3, 3));
+            _mm_storeu_ps(dst + i * 3 + 8,
+                          _mm_shuffle_ps(t, u, _MM_SHUFFLE(2, 0, 2, 0)));
+        }
+    }
+#endif
+    for (; i < count; i++) {
+        for (size_t c = 0; c < components; c++) {
+            dst[i * components + c] = src[c * count + i];
+        }
+    }
+}
+
+} // namespace peasyocl::utils
+
+#endif
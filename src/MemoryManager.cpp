@@ -0,0 +1,277 @@
+// Copyright 2024 viktorlanner
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "MemoryManager.h"
+
+#include <algorithm>
+
+namespace peasyocl {
+
+int MemoryManager::Init(cl::Context *context, cl::CommandQueue *queue,
+                        const cl::Device &device) {
+    std::lock_guard<std::recursive_mutex> lock(_mutex);
+    _context = context;
+    _queue = queue;
+
+    cl_ulong size = 0;
+    cl_int err = device.getInfo(CL_DEVICE_GLOBAL_MEM_SIZE, &size);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to query device memory size! %i\n", err);
+        return 1;
+    }
+    _deviceSize = static_cast<size_t>(size);
+    if (_budget == 0) {
+        _budget = _deviceSize;
+    }
+    return 0;
+}
+
+void MemoryManager::SetBudget(const size_t &bytes) {
+    std::lock_guard<std::recursive_mutex> lock(_mutex);
+    _budget = bytes > 0 ? bytes : _deviceSize;
+    if (_queue) {
+        Reserve(0);
+    }
+}
+
+int MemoryManager::Reserve(const size_t &size) {
+    std::lock_guard<std::recursive_mutex> lock(_mutex);
+    if (_budget == 0) {
+        return 0;
+    }
+
+    if (_usage + size > _budget) {
+        std::vector<BufferEntry *> candidates;
+        for (BufferEntry *entry : _lru) {
+            if (_IsEvictable(*entry)) {
+                candidates.push_back(entry);
+            }
+        }
+        std::stable_sort(candidates.begin(), candidates.end(),
+                         [](const BufferEntry *a, const BufferEntry *b) {
+                             return a->lastUse < b->lastUse;
+                         });
+        for (BufferEntry *entry : candidates) {
+            if (_usage + size <= _budget) {
+                break;
+            }
+            if (Evict(*entry) != 0) {
+                return 1;
+            }
+        }
+    }
+
+    if (_usage + size > _budget) {
+        printf("Warning: Allocation of %zu bytes exceeds the memory budget "
+               "of %zu bytes\n",
+               size, _budget);
+        return 1;
+    }
+    return 0;
+}
+
+void MemoryManager::Track(BufferEntry &entry) {
+    std::lock_guard<std::recursive_mutex> lock(_mutex);
+    if (entry.tracked) {
+        return;
+    }
+    _lru.push_front(&entry);
+    entry.lru = _lru.begin();
+    entry.tracked = true;
+    entry.lastUse = _epoch.load();
+    if (entry.resident) {
+        _usage += entry.size;
+    }
+}
+
+void MemoryManager::Release(BufferEntry &entry) {
+    std::lock_guard<std::recursive_mutex> lock(_mutex);
+    if (!entry.tracked) {
+        return;
+    }
+    _lru.erase(entry.lru);
+    entry.tracked = false;
+    if (entry.resident) {
+        _usage -= entry.size;
+    }
+}
+
+void MemoryManager::TrackFixed(const size_t &size) {
+    std::lock_guard<std::recursive_mutex> lock(_mutex);
+    _usage += size;
+}
+
+void MemoryManager::ReleaseFixed(const size_t &size) {
+    std::lock_guard<std::recursive_mutex> lock(_mutex);
+    _usage -= std::min(size, _usage);
+}
+
+int MemoryManager::Touch(BufferEntry &entry, const bool pin) {
+    // Pinning before checking residency pairs with Evict, which clears
+    // resident before checking the pins
+    if (pin) {
+        entry.pins.fetch_add(1);
+    }
+    entry.lastUse.store(_epoch.load(std::memory_order_relaxed),
+                        std::memory_order_relaxed);
+    if (entry.resident.load()) {
+        return 0;
+    }
+    std::lock_guard<std::recursive_mutex> lock(_mutex);
+    if (!entry.tracked) {
+        return 0;
+    }
+    return Restore(entry);
+}
+
+int MemoryManager::Evict(BufferEntry &entry) {
+    std::lock_guard<std::recursive_mutex> lock(_mutex);
+    if (!entry.resident) {
+        return 0;
+    }
+
+    // Claim the entry, so a launch pinning it from now on takes the locked
+    // path in Touch, then leave it to launches that already pinned it
+    entry.resident.store(false);
+    if (entry.pins.load() > 0) {
+        entry.resident.store(true);
+        return 0;
+    }
+
+    entry.host.resize(entry.size);
+    cl_int err = _queue->enqueueReadBuffer(*entry.buffer, CL_TRUE, 0,
+                                           entry.size, entry.host.data());
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to evict buffer %s! %i\n", entry.name.c_str(),
+               err);
+        entry.host = std::vector<unsigned char>();
+        entry.resident.store(true);
+        return 1;
+    }
+
+    {
+        std::lock_guard<std::mutex> swap(entry.bufferMutex);
+        *entry.buffer = cl::Buffer();
+    }
+    _usage -= entry.size;
+    return 0;
+}
+
+int MemoryManager::Restore(BufferEntry &entry) {
+    std::lock_guard<std::recursive_mutex> lock(_mutex);
+    if (entry.resident) {
+        return 0;
+    }
+
+    // Keep the entry from being picked while making room for it
+    entry.lastUse = _epoch.load();
+    Reserve(entry.size);
+
+    cl_int err;
+    cl_mem_flags flags = entry.flags & ~CL_MEM_COPY_HOST_PTR;
+    cl::Buffer buffer(*_context, flags, entry.size, nullptr, &err);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to restore buffer %s! %i\n", entry.name.c_str(),
+               err);
+        return 1;
+    }
+
+    err = _queue->enqueueWriteBuffer(buffer, CL_TRUE, 0, entry.size,
+                                     entry.host.data());
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to restore buffer %s! %i\n", entry.name.c_str(),
+               err);
+        return 1;
+    }
+
+    {
+        std::lock_guard<std::mutex> swap(entry.bufferMutex);
+        *entry.buffer = std::move(buffer);
+    }
+    entry.host = std::vector<unsigned char>();
+    entry.generation++;
+    entry.resident = true;
+    _usage += entry.size;
+    return 0;
+}
+
+size_t MemoryManager::EvictUnused() {
+    std::lock_guard<std::recursive_mutex> lock(_mutex);
+    size_t freed = 0;
+    for (BufferEntry *entry : _lru) {
+        // Evict leaves pinned entries resident
+        if (_IsEvictable(*entry) && Evict(*entry) == 0 && !entry->resident) {
+            freed += entry->size;
+        }
+    }
+    return freed;
+}
+
+BufferPin::BufferPin(MemoryManager *memory, BufferEntry *entry,
+                     const SharedBuffer &buffer) {
+    if (buffer == nullptr) {
+        printf("Error: Failed to use buffer, buffer is null!\n");
+        return;
+    }
+    if (!entry) {
+        _buffer = *buffer;
+        _status = 0;
+        return;
+    }
+
+    _memory = memory;
+    _entry = entry;
+    // Pinned even on failure, so Reset always unpins
+    if (_memory->Touch(*_entry, true) != 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(_entry->bufferMutex);
+    _buffer = *_entry->buffer;
+    _status = 0;
+}
+
+BufferPin::BufferPin(BufferPin &&other) noexcept { *this = std::move(other); }
+
+BufferPin &BufferPin::operator=(BufferPin &&other) noexcept {
+    if (this != &other) {
+        Reset();
+        _memory = other._memory;
+        _entry = other._entry;
+        _buffer = std::move(other._buffer);
+        _status = other._status;
+        other._memory = nullptr;
+        other._entry = nullptr;
+        other._status = 1;
+    }
+    return *this;
+}
+
+void BufferPin::Reset() {
+    if (_entry) {
+        _memory->Unpin(*_entry);
+    }
+    _memory = nullptr;
+    _entry = nullptr;
+    _buffer = cl::Buffer();
+    _status = 1;
+}
+
+bool MemoryManager::_IsEvictable(const BufferEntry &entry) const {
+    // Buffers backed by user memory can not be moved, and buffers used by
+    // the current kernel or pinned by a launch have to stay on the device
+    return entry.resident && entry.lastUse != _epoch && entry.pins == 0 &&
+           (entry.flags & CL_MEM_USE_HOST_PTR) == 0;
+}
+
+} // namespace peasyocl
@@ -0,0 +1,211 @@
+// Copyright 2024 viktorlanner
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef OCL_MEMORY_MANAGER_H
+#define OCL_MEMORY_MANAGER_H
+
+#include "HostMirror.h"
+#include "ShardedMap.h"
+#include "Types.h"
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace peasyocl {
+
+struct BufferEntry;
+
+using SharedMirror = std::shared_ptr<HostMirror>;
+using LruList = std::list<BufferEntry *>;
+
+/**
+ * @brief A buffer stored in the context. The mirror is only set for buffers
+ * created with AddMirroredArgument. While a buffer is evicted its data lives
+ * in host and buffer holds an empty cl::Buffer. The fields read on every
+ * lookup are atomic, the rest only change under the memory manager's lock.
+ * The cl::Buffer object is only swapped under bufferMutex
+ *
+ */
+struct BufferEntry {
+    std::string name;
+    SharedBuffer buffer;
+    size_t size = 0;
+    SharedMirror mirror;
+    cl_mem_flags flags = 0;
+
+    // Memory manager state
+    std::vector<unsigned char> host;
+    LruList::iterator lru;
+    bool tracked = false;
+    std::atomic<bool> resident{true};
+    std::atomic<unsigned> generation{0};
+    std::atomic<unsigned> lastUse{0};
+    std::atomic<int> users{0};
+    // Launches between binding the buffer and enqueueing the kernel
+    std::atomic<int> pins{0};
+    std::mutex bufferMutex;
+};
+
+using BufferMap = ShardedMap<std::string, BufferEntry>;
+
+/**
+ * @brief Accounts device allocations against a budget. When an allocation
+ * would exceed the budget the least recently used buffers are copied to host
+ * memory and released, and restored again on next use. Safe to use from
+ * several threads. Touching a resident buffer takes no lock, so recency is
+ * tracked per use rather than per touch. Launches pin their buffers until
+ * the kernel is enqueued, and pinned buffers are never evicted
+ *
+ */
+class MemoryManager {
+  public:
+    /**
+     * @brief Set up the manager for a device. The budget defaults to
+     * CL_DEVICE_GLOBAL_MEM_SIZE
+     *
+     * @param context
+     * @param queue Queue used to copy evicted buffers to and from the host
+     * @param device
+     * @return int
+     */
+    int Init(cl::Context *context, cl::CommandQueue *queue,
+             const cl::Device &device);
+
+    /**
+     * @brief Set the budget in bytes. A budget of 0 resets to the device
+     * global memory size. Evicts buffers if the usage is above the new budget
+     *
+     * @param bytes
+     */
+    void SetBudget(const size_t &bytes);
+    size_t GetBudget() const {
+        std::lock_guard<std::recursive_mutex> lock(_mutex);
+        return _budget;
+    }
+    size_t GetUsage() const {
+        std::lock_guard<std::recursive_mutex> lock(_mutex);
+        return _usage;
+    }
+
+    /**
+     * @brief Make room for an allocation of size bytes by evicting least
+     * recently used buffers
+     *
+     * @param size Size in bytes
+     * @return int 1 if the budget could not be met
+     */
+    int Reserve(const size_t &size);
+
+    /**
+     * @brief Start accounting for entry. The entry must stay at the same
+     * address until Release
+     *
+     * @param entry
+     */
+    void Track(BufferEntry &entry);
+    void Release(BufferEntry &entry);
+
+    /**
+     * @brief Account for an allocation that is never evicted, such as an
+     * image. Call Reserve first to make room for it
+     *
+     * @param size Size in bytes
+     */
+    void TrackFixed(const size_t &size);
+    void ReleaseFixed(const size_t &size);
+
+    /**
+     * @brief Start a new use. Buffers touched after this are not evicted
+     * until the next call
+     *
+     */
+    void BeginUse() { _epoch.fetch_add(1, std::memory_order_relaxed); }
+
+    /**
+     * @brief Mark entry as most recently used and restore it if it was
+     * evicted
+     *
+     * @param entry
+     * @param pin Also keep entry from being evicted until Unpin. Pinned
+     * even if the restore fails
+     * @return int
+     */
+    int Touch(BufferEntry &entry, const bool pin = false);
+    void Unpin(BufferEntry &entry) { entry.pins.fetch_sub(1); }
+
+    int Evict(BufferEntry &entry);
+    int Restore(BufferEntry &entry);
+
+    /**
+     * @brief Evict every buffer that is not used by the current use
+     *
+     * @return size_t Bytes freed
+     */
+    size_t EvictUnused();
+
+  private:
+    bool _IsEvictable(const BufferEntry &entry) const;
+
+    // Recursive since restoring a buffer evicts others to make room
+    mutable std::recursive_mutex _mutex;
+    cl::Context *_context = nullptr;
+    cl::CommandQueue *_queue = nullptr;
+    LruList _lru;
+    size_t _deviceSize = 0;
+    size_t _budget = 0;
+    size_t _usage = 0;
+    std::atomic<unsigned> _epoch{1};
+};
+
+/**
+ * @brief Keeps a buffer on the device for one transfer. A tracked buffer is
+ * restored if it was evicted and pinned until the pin is destroyed, and its
+ * cl::Buffer is copied under the entry's lock. Other buffers are used as
+ * given. Enqueue the transfer through Get() while the pin is alive
+ *
+ */
+class BufferPin {
+  public:
+    BufferPin() = default;
+    BufferPin(MemoryManager *memory, BufferEntry *entry,
+              const SharedBuffer &buffer);
+    ~BufferPin() { Reset(); }
+    BufferPin(BufferPin &&other) noexcept;
+    BufferPin &operator=(BufferPin &&other) noexcept;
+    BufferPin(const BufferPin &) = delete;
+    BufferPin &operator=(const BufferPin &) = delete;
+
+    bool IsValid() const { return _status == 0; }
+    explicit operator bool() const { return IsValid(); }
+    cl::Buffer &Get() { return _buffer; }
+
+    /**
+     * @brief Unpin the buffer early
+     *
+     */
+    void Reset();
+
+  private:
+    MemoryManager *_memory = nullptr;
+    BufferEntry *_entry = nullptr;
+    cl::Buffer _buffer;
+    int _status = 1;
+};
+
+} // namespace peasyocl
+
+#endif
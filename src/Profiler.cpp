@@ -0,0 +1,181 @@
+// Copyright 2024 viktorlanner
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "Profiler.h"
+
+#include <algorithm>
+
+namespace peasyocl {
+
+static void AddSample(std::vector<double> &samples, const size_t &next,
+                      const double &value) {
+    if (samples.size() < Profiler::MaxSamples) {
+        samples.push_back(value);
+    } else {
+        samples[next] = value;
+    }
+}
+
+static TimingStats Summarize(std::vector<double> samples) {
+    TimingStats stats;
+    if (samples.empty()) {
+        return stats;
+    }
+    std::sort(samples.begin(), samples.end());
+
+    double sum = 0.0;
+    for (double sample : samples) {
+        sum += sample;
+    }
+
+    // Nearest rank percentiles
+    auto percentile = [&](double p) {
+        size_t rank = static_cast<size_t>(p * samples.size() + 0.5);
+        return samples[std::min(rank > 0 ? rank - 1 : 0, samples.size() - 1)];
+    };
+
+    stats.count = samples.size();
+    stats.mean = sum / samples.size();
+    stats.p50 = percentile(0.50);
+    stats.p95 = percentile(0.95);
+    stats.p99 = percentile(0.99);
+    stats.max = samples.back();
+    return stats;
+}
+
+int Profiler::Record(const std::string &key, const cl::Event &event,
+                     const bool kernel) {
+    cl_ulong timestamps[4];
+    if (_GetTimestamps(key, event, timestamps) != 0) {
+        return 1;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _AddSamples(kernel ? _kernels[key] : _buffers[key], timestamps);
+    return 0;
+}
+
+int Profiler::RecordTransfer(const std::string &name, const cl::Event &event,
+                             const TransferDirection &direction,
+                             const size_t &bytes) {
+    cl_ulong timestamps[4];
+    if (_GetTimestamps(name, event, timestamps) != 0) {
+        return 1;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _AddSamples(_buffers[name], timestamps);
+
+    TransferStats &stats = _transfers[name];
+    stats.name = name;
+    TransferCounters &counters =
+        direction == TransferDirection::Upload     ? stats.upload
+        : direction == TransferDirection::Download ? stats.download
+                                                   : stats.copy;
+    counters.count++;
+    counters.bytes += bytes;
+    counters.time += double(timestamps[3] - timestamps[2]);
+    return 0;
+}
+
+ProfileStats Profiler::GetKernelStats(const std::string &key) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto found = _kernels.find(key);
+    if (found == _kernels.end()) {
+        return {};
+    }
+    return _Summarize(found->second);
+}
+
+ProfileStats Profiler::GetBufferStats(const std::string &name) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto found = _buffers.find(name);
+    if (found == _buffers.end()) {
+        return {};
+    }
+    return _Summarize(found->second);
+}
+
+ProfileMap Profiler::GetKernelStats() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _SummarizeAll(_kernels);
+}
+
+ProfileMap Profiler::GetBufferStats() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _SummarizeAll(_buffers);
+}
+
+TransferReport Profiler::GetTransferReport() const {
+    TransferReport report;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        report.reserve(_transfers.size());
+        for (auto &[name, stats] : _transfers) {
+            report.push_back(stats);
+        }
+    }
+    std::sort(report.begin(), report.end(),
+              [](const TransferStats &a, const TransferStats &b) {
+                  return a.TotalTime() > b.TotalTime();
+              });
+    return report;
+}
+
+void Profiler::Reset() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _kernels.clear();
+    _buffers.clear();
+    _transfers.clear();
+}
+
+int Profiler::_GetTimestamps(const std::string &key, const cl::Event &event,
+                             cl_ulong (&timestamps)[4]) {
+    cl_int err =
+        event.getProfilingInfo(CL_PROFILING_COMMAND_QUEUED, &timestamps[0]);
+    err |= event.getProfilingInfo(CL_PROFILING_COMMAND_SUBMIT, &timestamps[1]);
+    err |= event.getProfilingInfo(CL_PROFILING_COMMAND_START, &timestamps[2]);
+    err |= event.getProfilingInfo(CL_PROFILING_COMMAND_END, &timestamps[3]);
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to get profiling info for %s!\n", key.c_str());
+        return 1;
+    }
+    return 0;
+}
+
+void Profiler::_AddSamples(Samples &samples,
+                           const cl_ulong (&timestamps)[4]) {
+    AddSample(samples.queued, samples.next,
+              double(timestamps[1] - timestamps[0]));
+    AddSample(samples.submitted, samples.next,
+              double(timestamps[2] - timestamps[1]));
+    AddSample(samples.device, samples.next,
+              double(timestamps[3] - timestamps[2]));
+    samples.next = (samples.next + 1) % MaxSamples;
+}
+
+ProfileStats Profiler::_Summarize(const Samples &samples) {
+    return {Summarize(samples.queued), Summarize(samples.submitted),
+            Summarize(samples.device)};
+}
+
+ProfileMap Profiler::_SummarizeAll(const SampleMap &samples) {
+    ProfileMap result;
+    for (auto &[key, value] : samples) {
+        result[key] = _Summarize(value);
+    }
+    return result;
+}
+
+} // namespace peasyocl
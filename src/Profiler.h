@@ -0,0 +1,161 @@
+// Copyright 2024 viktorlanner
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef OCL_PROFILER_H
+#define OCL_PROFILER_H
+
+#include "Types.h"
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace peasyocl {
+
+/**
+ * @brief Distribution of a set of timings in nanoseconds
+ *
+ */
+struct TimingStats {
+    size_t count = 0;
+    double mean = 0.0;
+    double p50 = 0.0;
+    double p95 = 0.0;
+    double p99 = 0.0;
+    double max = 0.0;
+};
+
+/**
+ * @brief Timings of the commands recorded for one kernel or buffer. queued
+ * is the time from CL_PROFILING_COMMAND_QUEUED to CL_PROFILING_COMMAND_SUBMIT,
+ * submitted from submit to CL_PROFILING_COMMAND_START and device from start
+ * to CL_PROFILING_COMMAND_END
+ *
+ */
+struct ProfileStats {
+    TimingStats queued;
+    TimingStats submitted;
+    TimingStats device;
+};
+
+using ProfileMap = std::map<std::string, ProfileStats>;
+
+enum class TransferDirection { Upload, Download, Copy };
+
+/**
+ * @brief Bytes moved and device time spent in one direction. time is in
+ * nanoseconds, so Bandwidth() is in GB/s
+ *
+ */
+struct TransferCounters {
+    size_t count = 0;
+    size_t bytes = 0;
+    double time = 0.0;
+
+    double Bandwidth() const { return time > 0.0 ? bytes / time : 0.0; }
+};
+
+/**
+ * @brief Transfer counters of one buffer. Copies and fills are counted on
+ * the destination buffer
+ *
+ */
+struct TransferStats {
+    std::string name;
+    TransferCounters upload;
+    TransferCounters download;
+    TransferCounters copy;
+
+    size_t TotalBytes() const {
+        return upload.bytes + download.bytes + copy.bytes;
+    }
+    double TotalTime() const { return upload.time + download.time + copy.time; }
+};
+
+using TransferReport = std::vector<TransferStats>;
+
+/**
+ * @brief Collects the profiling timestamps of completed events, keyed by
+ * kernel key or buffer name. Keeps the last MaxSamples timings per key
+ *
+ */
+class Profiler {
+  public:
+    static constexpr size_t MaxSamples = 4096;
+
+    /**
+     * @brief Record the timestamps of a completed event. The event must come
+     * from a queue created with CL_QUEUE_PROFILING_ENABLE
+     *
+     * @param key Kernel key or buffer name
+     * @param event Completed event
+     * @param kernel Whether the event is a kernel launch or a transfer
+     * @return int
+     */
+    int Record(const std::string &key, const cl::Event &event,
+               const bool kernel);
+
+    /**
+     * @brief Record the timestamps of a completed transfer and add its bytes
+     * and duration to the counters of buffer name
+     *
+     * @param name Buffer name
+     * @param event Completed event
+     * @param direction
+     * @param bytes Bytes moved by the transfer
+     * @return int
+     */
+    int RecordTransfer(const std::string &name, const cl::Event &event,
+                       const TransferDirection &direction,
+                       const size_t &bytes);
+
+    ProfileStats GetKernelStats(const std::string &key) const;
+    ProfileStats GetBufferStats(const std::string &name) const;
+    ProfileMap GetKernelStats() const;
+    ProfileMap GetBufferStats() const;
+
+    /**
+     * @brief Get the transfer counters of every buffer, ranked by total
+     * transfer time
+     *
+     * @return TransferReport
+     */
+    TransferReport GetTransferReport() const;
+    void Reset();
+
+  private:
+    struct Samples {
+        std::vector<double> queued;
+        std::vector<double> submitted;
+        std::vector<double> device;
+        size_t next = 0;
+    };
+    using SampleMap = std::map<std::string, Samples>;
+
+    static int _GetTimestamps(const std::string &key, const cl::Event &event,
+                              cl_ulong (&timestamps)[4]);
+    static void _AddSamples(Samples &samples,
+                            const cl_ulong (&timestamps)[4]);
+    static ProfileStats _Summarize(const Samples &samples);
+    static ProfileMap _SummarizeAll(const SampleMap &samples);
+
+    mutable std::mutex _mutex;
+    SampleMap _kernels;
+    SampleMap _buffers;
+    std::map<std::string, TransferStats> _transfers;
+};
+
+} // namespace peasyocl
+
+#endif
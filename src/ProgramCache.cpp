@@ -0,0 +1,100 @@
+// Copyright 2024 viktorlanner
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "ProgramCache.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace peasyocl {
+
+bool ProgramCache::Find(const std::string &code, const std::string &flags,
+                        cl::Program *program, std::string *log) const {
+    std::string key = _CacheKey(code, flags);
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto found = _programs.find(key);
+    if (found == _programs.end()) {
+        return false;
+    }
+    *program = found->second.program;
+    if (log) {
+        *log = found->second.log;
+    }
+    return true;
+}
+
+void ProgramCache::Insert(const std::string &code, const std::string &flags,
+                          const cl::Program &program, const std::string &log) {
+    std::string key = _CacheKey(code, flags);
+    std::lock_guard<std::mutex> lock(_mutex);
+    _programs[key] = {program, log};
+}
+
+void ProgramCache::Record(BuildRecord record) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _records.push_back(std::move(record));
+}
+
+bool ProgramCache::GetRecord(const std::string &key,
+                             BuildRecord *record) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (auto it = _records.rbegin(); it != _records.rend(); ++it) {
+        if (it->key == key) {
+            *record = *it;
+            return true;
+        }
+    }
+    return false;
+}
+
+BuildReport ProgramCache::GetReport() const {
+    BuildReport report;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        report = _records;
+    }
+    std::stable_sort(report.begin(), report.end(),
+                     [](const BuildRecord &a, const BuildRecord &b) {
+                         return a.time > b.time;
+                     });
+    return report;
+}
+
+void ProgramCache::Print() const {
+    BuildReport report = GetReport();
+    double total = 0.0;
+    for (const BuildRecord &record : report) {
+        total += record.time;
+    }
+
+    printf("%-24s %10s %12s %7s %6s  %s\n", "Kernel", "Source", "Time (ms)",
+           "Share", "Cache", "Flags");
+    for (const BuildRecord &record : report) {
+        printf("%-24s %10zu %12.2f %6.1f%% %6s  %s%s\n", record.key.c_str(),
+               record.sourceSize, record.time / 1e6,
+               total > 0.0 ? 100.0 * record.time / total : 0.0,
+               record.cacheHit ? "hit" : "miss", record.flags.c_str(),
+               record.success ? "" : " (failed)");
+    }
+    printf("Total build time %.2f ms\n", total / 1e6);
+}
+
+void ProgramCache::Clear() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _programs.clear();
+    _records.clear();
+}
+
+} // namespace peasyocl
@@ -0,0 +1,112 @@
+// Copyright 2024 viktorlanner
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef OCL_PROGRAM_CACHE_H
+#define OCL_PROGRAM_CACHE_H
+
+#include "Types.h"
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace peasyocl {
+
+/**
+ * @brief Telemetry of one AddKernel build. time is in nanoseconds and covers
+ * program creation and compilation. A cache hit reused an already built
+ * program with the same source and flags, its time covers the lookup and its
+ * log is the log of the original build
+ *
+ */
+struct BuildRecord {
+    std::string key;
+    std::string kernelName;
+    std::string flags;
+    size_t sourceSize = 0;
+    double time = 0.0;
+    bool cacheHit = false;
+    bool success = false;
+    std::string log;
+};
+
+using BuildReport = std::vector<BuildRecord>;
+
+/**
+ * @brief Built programs keyed by source and build flags, so kernels from the
+ * same source are only compiled once. Also keeps a record of every build.
+ * Safe to use from several threads
+ *
+ */
+class ProgramCache {
+  public:
+    /**
+     * @brief Find a built program with matching source and flags
+     *
+     * @param code
+     * @param flags
+     * @param program Set to the cached program if there is one
+     * @param log Set to the build log of the cached program, if not null
+     * @return bool
+     */
+    bool Find(const std::string &code, const std::string &flags,
+              cl::Program *program, std::string *log = nullptr) const;
+    void Insert(const std::string &code, const std::string &flags,
+                const cl::Program &program, const std::string &log);
+
+    void Record(BuildRecord record);
+
+    /**
+     * @brief Get the latest build record of a kernel key
+     *
+     * @param key
+     * @param record Set to the record if key was built
+     * @return bool false if key was never built
+     */
+    bool GetRecord(const std::string &key, BuildRecord *record) const;
+
+    /**
+     * @brief Get every build record, ranked by build time
+     *
+     * @return BuildReport
+     */
+    BuildReport GetReport() const;
+    void Print() const;
+
+    /**
+     * @brief Drop the cached programs and the build records
+     *
+     */
+    void Clear();
+
+  private:
+    static std::string _CacheKey(const std::string &code,
+                                 const std::string &flags) {
+        return flags + '\n' + code;
+    }
+
+    mutable std::mutex _mutex;
+    struct CachedProgram {
+        cl::Program program;
+        std::string log;
+    };
+
+    std::unordered_map<std::string, CachedProgram> _programs;
+    std::vector<BuildRecord> _records;
+};
+
+} // namespace peasyocl
+
+#endif
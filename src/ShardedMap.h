@@ -0,0 +1,144 @@
+// Copyright 2024 viktorlanner
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef OCL_SHARDED_MAP_H
+#define OCL_SHARDED_MAP_H
+
+#include <array>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace peasyocl {
+
+/**
+ * @brief A map split into shards by key hash, each behind its own
+ * reader-writer lock. Lookups only take a shared lock on one shard, so
+ * threads looking up different or the same keys do not block each other.
+ * Values stay at the same address until they are erased
+ *
+ * @tparam Key
+ * @tparam Value
+ * @tparam ShardCount
+ */
+template <typename Key, typename Value, size_t ShardCount = 16>
+class ShardedMap {
+  public:
+    /**
+     * @brief Find the value under key
+     *
+     * @param key
+     * @return Value* nullptr if there is none
+     */
+    Value *Find(const Key &key) {
+        return const_cast<Value *>(std::as_const(*this).Find(key));
+    }
+    const Value *Find(const Key &key) const {
+        const Shard &shard = _ShardFor(key);
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        auto found = shard.values.find(key);
+        if (found == shard.values.end()) {
+            return nullptr;
+        }
+        return &found->second;
+    }
+
+    bool Contains(const Key &key) const { return Find(key) != nullptr; }
+
+    /**
+     * @brief Insert a default constructed value under key and set it up with
+     * init while its shard is still locked, so no other thread sees it half
+     * done. Does nothing if there already is a value under key
+     *
+     * @tparam Init Called with Value &
+     * @return std::pair<Value *, bool> The value under key, and whether it
+     * was inserted
+     */
+    template <typename Init>
+    std::pair<Value *, bool> TryEmplace(const Key &key, Init init) {
+        Shard &shard = _ShardFor(key);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        auto [it, inserted] = shard.values.try_emplace(key);
+        if (inserted) {
+            init(it->second);
+        }
+        return {&it->second, inserted};
+    }
+
+    /**
+     * @brief Set the value under key, replacing an existing value in place
+     *
+     * @return Value* The value under key
+     */
+    template <typename V> Value *InsertOrAssign(const Key &key, V &&value) {
+        Shard &shard = _ShardFor(key);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        auto it =
+            shard.values.insert_or_assign(key, std::forward<V>(value)).first;
+        return &it->second;
+    }
+
+    bool Erase(const Key &key) {
+        Shard &shard = _ShardFor(key);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        return shard.values.erase(key) > 0;
+    }
+
+    /**
+     * @brief Call visit with every key and value, one shard at a time under
+     * its shared lock. visit must not modify the map
+     *
+     * @tparam Visit
+     * @param visit
+     */
+    template <typename Visit> void ForEach(Visit visit) const {
+        for (const Shard &shard : _shards) {
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+            for (const auto &[key, value] : shard.values) {
+                visit(key, value);
+            }
+        }
+    }
+
+    size_t Size() const {
+        size_t size = 0;
+        for (const Shard &shard : _shards) {
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+            size += shard.values.size();
+        }
+        return size;
+    }
+
+  private:
+    struct Shard {
+        mutable std::shared_mutex mutex;
+        std::unordered_map<Key, Value> values;
+    };
+
+    Shard &_ShardFor(const Key &key) {
+        return _shards[std::hash<Key>()(key) % ShardCount];
+    }
+    const Shard &_ShardFor(const Key &key) const {
+        return _shards[std::hash<Key>()(key) % ShardCount];
+    }
+
+    std::array<Shard, ShardCount> _shards;
+};
+
+} // namespace peasyocl
+
+#endif
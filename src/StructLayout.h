@@ -0,0 +1,161 @@
+// Copyright 2024 viktorlanner
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef OCL_STRUCT_LAYOUT_H
+#define OCL_STRUCT_LAYOUT_H
+
+#include "Types.h"
+#include <cstddef>
+#include <type_traits>
+
+namespace peasyocl {
+
+/**
+ * @brief Alignment OpenCL requires for a type used in a kernel struct. Only
+ * the fixed width cl_<type> scalars, the cl_<type><n> vectors and arrays of
+ * them have one. Scalars and vectors are aligned to their size, with 3
+ * component vectors padded to 4. Nested structs can be given one by
+ * specializing this template
+ *
+ * The cl_<type> scalars are typedefs of the fixed width integer types, so a
+ * host type of the same width is accepted as well, e.g. size_t where it is
+ * the same type as cl_ulong. cl_half is a typedef of cl_ushort. Plain char,
+ * bool, long double and long where it is 32 bit wide are rejected
+ *
+ * @tparam T
+ */
+template <typename T, typename = void> struct ClAlignment {};
+
+#define PEASYOCL_CL_SCALAR(Type)                                               \
+    template <>                                                                \
+    struct ClAlignment<Type, void>                                             \
+        : std::integral_constant<size_t, sizeof(Type)> {}
+
+PEASYOCL_CL_SCALAR(cl_char);
+PEASYOCL_CL_SCALAR(cl_uchar);
+PEASYOCL_CL_SCALAR(cl_short);
+PEASYOCL_CL_SCALAR(cl_ushort);
+PEASYOCL_CL_SCALAR(cl_int);
+PEASYOCL_CL_SCALAR(cl_uint);
+PEASYOCL_CL_SCALAR(cl_long);
+PEASYOCL_CL_SCALAR(cl_ulong);
+PEASYOCL_CL_SCALAR(cl_float);
+PEASYOCL_CL_SCALAR(cl_double);
+
+#undef PEASYOCL_CL_SCALAR
+
+template <typename T, typename = void>
+struct HasClAlignment : std::false_type {};
+
+template <typename T>
+struct HasClAlignment<T, std::void_t<decltype(ClAlignment<T>::value)>>
+    : std::true_type {};
+
+// The cl_<type><n> vector types are unions over an s array of a scalar
+template <typename T>
+struct ClAlignment<
+    T, std::enable_if_t<
+           std::is_union<T>::value && std::is_array<decltype(T::s)>::value &&
+           HasClAlignment<std::remove_extent_t<decltype(T::s)>>::value>>
+    : std::integral_constant<size_t, sizeof(T)> {};
+
+template <typename T, size_t N>
+struct ClAlignment<T[N], void> : ClAlignment<T> {};
+
+/**
+ * @brief ClAlignment of T, or the host alignment if T has no OpenCL
+ * equivalent so that only the first failing check reports
+ *
+ * @tparam T
+ * @return constexpr size_t
+ */
+template <typename T> constexpr size_t ClAlignmentOf() {
+    if constexpr (HasClAlignment<T>::value) {
+        return ClAlignment<T>::value;
+    } else {
+        return alignof(T);
+    }
+}
+
+/**
+ * @brief Round offset up to a multiple of alignment
+ *
+ * @param offset
+ * @param alignment
+ * @return constexpr size_t
+ */
+constexpr size_t ClAlignUp(const size_t offset, const size_t alignment) {
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+/**
+ * @brief Whether T can be copied byte for byte into a kernel argument
+ *
+ * @tparam T
+ */
+template <typename T>
+struct IsClStruct
+    : std::integral_constant<bool, std::is_trivially_copyable<T>::value &&
+                                       std::is_standard_layout<T>::value> {};
+
+} // namespace peasyocl
+
+/**
+ * @brief Check at compile time that a struct member has an OpenCL type with
+ * the same alignment on the host. Use for the first member, and
+ * PEASYOCL_CHECK_NEXT_MEMBER for the ones after it
+ *
+ */
+#define PEASYOCL_CHECK_MEMBER(Struct, member)                                  \
+    static_assert(                                                             \
+        ::peasyocl::HasClAlignment<decltype(Struct::member)>::value,           \
+        #Struct "::" #member " has no OpenCL equivalent");                     \
+    static_assert(alignof(decltype(Struct::member)) ==                         \
+                      ::peasyocl::ClAlignmentOf<decltype(Struct::member)>(),   \
+                  #Struct "::" #member " is aligned differently on the host")
+
+/**
+ * @brief Check at compile time that member follows previous at the offset
+ * OpenCL gives it, the end of previous rounded up to the member's alignment
+ *
+ */
+#define PEASYOCL_CHECK_NEXT_MEMBER(Struct, member, previous)                   \
+    PEASYOCL_CHECK_MEMBER(Struct, member);                                     \
+    static_assert(offsetof(Struct, member) ==                                  \
+                      ::peasyocl::ClAlignUp(                                   \
+                          offsetof(Struct, previous) +                         \
+                              sizeof(Struct::previous),                        \
+                          ::peasyocl::ClAlignmentOf<                           \
+                              decltype(Struct::member)>()),                    \
+                  #Struct "::" #member " is not at its OpenCL offset")
+
+/**
+ * @brief Check at compile time that a struct can be passed to a kernel and
+ * that its size is the end of its last member rounded up to the struct's
+ * alignment. With every member checked, the host alignment of the struct is
+ * the largest OpenCL alignment of its members, so host and device agree on
+ * the layout and size
+ *
+ */
+#define PEASYOCL_CHECK_STRUCT(Struct, last)                                    \
+    static_assert(::peasyocl::IsClStruct<Struct>::value,                       \
+                  #Struct " is not trivially copyable with standard layout");  \
+    static_assert(sizeof(Struct) ==                                            \
+                      ::peasyocl::ClAlignUp(offsetof(Struct, last) +           \
+                                                sizeof(Struct::last),          \
+                                            alignof(Struct)),                  \
+                  #Struct " has a different size in OpenCL")
+
+#endif
@@ -0,0 +1,192 @@
+// Copyright 2024 viktorlanner
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "TraceRecorder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <vector>
+
+namespace peasyocl {
+
+static uint32_t ThreadId() {
+    static std::atomic<uint32_t> next{1};
+    thread_local uint32_t id = next.fetch_add(1, std::memory_order_relaxed);
+    return id;
+}
+
+static void AppendEscaped(std::string &out, const char *text) {
+    for (const char *c = text; *c; c++) {
+        switch (*c) {
+        case '"':
+            out += "\\\"";
+            break;
+        case '\\':
+            out += "\\\\";
+            break;
+        default:
+            if (static_cast<unsigned char>(*c) < 0x20) {
+                out += ' ';
+            } else {
+                out += *c;
+            }
+        }
+    }
+}
+
+TraceRecorder::TraceRecorder(const size_t &capacity)
+    : _deviceOffset(std::numeric_limits<int64_t>::max()) {
+    // Round up to a power of two so the slot is a mask of the position
+    size_t size = 1;
+    while (size < std::max<size_t>(capacity, 2)) {
+        size <<= 1;
+    }
+    _slots.reset(new Slot[size]);
+    _mask = size - 1;
+}
+
+uint64_t TraceRecorder::Now() {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+
+void TraceRecorder::RecordHost(const char *category, const std::string &name,
+                               const uint64_t &start, const uint64_t &end) {
+    if (!IsEnabled()) {
+        return;
+    }
+    _Write(category, name, start, end - start, TraceLane::Host, ThreadId());
+}
+
+void TraceRecorder::RecordDevice(const char *category, const std::string &name,
+                                 const cl::Event &event) {
+    if (!IsEnabled()) {
+        return;
+    }
+
+    cl_ulong queued, start, end;
+    cl_int err = event.getProfilingInfo(CL_PROFILING_COMMAND_QUEUED, &queued);
+    err |= event.getProfilingInfo(CL_PROFILING_COMMAND_START, &start);
+    err |= event.getProfilingInfo(CL_PROFILING_COMMAND_END, &end);
+    if (err != CL_SUCCESS) {
+        return;
+    }
+
+    // The event has completed, so the host clock is at or past its end. The
+    // smallest difference seen is the closest estimate of the clock offset
+    int64_t offset = static_cast<int64_t>(Now()) - static_cast<int64_t>(end);
+    int64_t current = _deviceOffset.load(std::memory_order_relaxed);
+    while (offset < current &&
+           !_deviceOffset.compare_exchange_weak(current, offset,
+                                                std::memory_order_relaxed)) {
+    }
+    offset = std::min(offset, current);
+
+    _Write(category, name, queued + offset, start - queued, TraceLane::Queue,
+           1);
+    _Write(category, name, start + offset, end - start, TraceLane::Device, 1);
+}
+
+void TraceRecorder::_Write(const char *category, const std::string &name,
+                           const uint64_t &start, const uint64_t &duration,
+                           const TraceLane &lane, const uint32_t &thread) {
+    uint64_t position = _head.fetch_add(1, std::memory_order_relaxed);
+    Slot &slot = _slots[position & _mask];
+
+    slot.sequence.store(position * 2 + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    size_t length = std::min(name.size(), MaxNameLength);
+    std::memcpy(slot.span.name, name.data(), length);
+    slot.span.name[length] = '\0';
+    slot.span.category = category;
+    slot.span.start = start;
+    slot.span.duration = duration;
+    slot.span.lane = static_cast<uint32_t>(lane);
+    slot.span.thread = thread;
+
+    slot.sequence.store(position * 2 + 2, std::memory_order_release);
+}
+
+std::string TraceRecorder::ToChromeTrace() const {
+    uint64_t head = _head.load(std::memory_order_acquire);
+    uint64_t first = head > _mask + 1 ? head - (_mask + 1) : 0;
+
+    std::vector<Span> spans;
+    spans.reserve(head - first);
+    for (uint64_t position = first; position < head; position++) {
+        const Slot &slot = _slots[position & _mask];
+        uint64_t before = slot.sequence.load(std::memory_order_acquire);
+        if (before != position * 2 + 2) {
+            continue;
+        }
+        Span span = slot.span;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != before) {
+            continue;
+        }
+        spans.push_back(span);
+    }
+
+    std::string json = "{\"traceEvents\":[\n";
+    json += "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+            "\"args\":{\"name\":\"Host\"}},\n";
+    json += "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":2,"
+            "\"args\":{\"name\":\"Device\"}},\n";
+    json += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":2,\"tid\":2,"
+            "\"args\":{\"name\":\"Queue\"}},\n";
+    json += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":2,\"tid\":3,"
+            "\"args\":{\"name\":\"Execution\"}}";
+
+    char numbers[128];
+    for (const Span &span : spans) {
+        bool host = span.lane == static_cast<uint32_t>(TraceLane::Host);
+        json += ",\n{\"name\":\"";
+        AppendEscaped(json, span.name);
+        json += "\",\"cat\":\"";
+        AppendEscaped(json, span.category);
+        snprintf(numbers, sizeof(numbers),
+                 "\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%u,"
+                 "\"tid\":%u}",
+                 span.start / 1000.0, span.duration / 1000.0, host ? 1u : 2u,
+                 host ? span.thread : span.lane);
+        json += numbers;
+    }
+    json += "\n],\"displayTimeUnit\":\"ns\"}\n";
+    return json;
+}
+
+int TraceRecorder::WriteChromeTrace(const std::string &path) const {
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        printf("Error: Failed to open trace file %s!\n", path.c_str());
+        return 1;
+    }
+    file << ToChromeTrace();
+    return file.good() ? 0 : 1;
+}
+
+void TraceRecorder::Clear() {
+    // Invalidate the slots by moving the head past them
+    uint64_t head = _head.load(std::memory_order_relaxed);
+    _head.store(head + _mask + 1, std::memory_order_release);
+}
+
+} // namespace peasyocl
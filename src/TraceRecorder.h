@@ -0,0 +1,155 @@
+// Copyright 2024 viktorlanner
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef OCL_TRACE_RECORDER_H
+#define OCL_TRACE_RECORDER_H
+
+#include "Types.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace peasyocl {
+
+/**
+ * @brief Lane a span is drawn in. Host spans are drawn per host thread,
+ * device spans in a queue lane (queued to start) and an execution lane
+ * (start to end)
+ *
+ */
+enum class TraceLane : uint32_t { Host = 1, Queue = 2, Device = 3 };
+
+/**
+ * @brief Records host and device spans into a lock free ring buffer and
+ * writes them as Chrome trace event JSON, which can be opened in
+ * chrome://tracing or Perfetto. When disabled, recording is a single relaxed
+ * atomic load
+ *
+ */
+class TraceRecorder {
+  public:
+    static constexpr size_t DefaultCapacity = 1 << 16;
+    static constexpr size_t MaxNameLength = 63;
+
+    explicit TraceRecorder(const size_t &capacity = DefaultCapacity);
+
+    void SetEnabled(const bool enabled) {
+        _enabled.store(enabled, std::memory_order_relaxed);
+    }
+    bool IsEnabled() const {
+        return _enabled.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Record a span on the calling host thread
+     *
+     * @param category Static string, e.g. "kernel" or "transfer"
+     * @param name Name of the span. Truncated to MaxNameLength
+     * @param start Start time from Now()
+     * @param end End time from Now()
+     */
+    void RecordHost(const char *category, const std::string &name,
+                    const uint64_t &start, const uint64_t &end);
+
+    /**
+     * @brief Record the queue and execution spans of a completed event. The
+     * event must come from a queue created with CL_QUEUE_PROFILING_ENABLE
+     *
+     * @param category Static string, e.g. "kernel" or "transfer"
+     * @param name Name of the span. Truncated to MaxNameLength
+     * @param event Completed event
+     */
+    void RecordDevice(const char *category, const std::string &name,
+                      const cl::Event &event);
+
+    /**
+     * @brief Build the Chrome trace event JSON of the recorded spans. Spans
+     * overwritten by newer ones are dropped
+     *
+     * @return std::string
+     */
+    std::string ToChromeTrace() const;
+    int WriteChromeTrace(const std::string &path) const;
+    void Clear();
+
+    /**
+     * @brief Host time in nanoseconds
+     *
+     * @return uint64_t
+     */
+    static uint64_t Now();
+
+  private:
+    struct Span {
+        char name[MaxNameLength + 1];
+        const char *category;
+        uint64_t start;
+        uint64_t duration;
+        uint32_t lane;
+        uint32_t thread;
+    };
+
+    // Even sequence numbers mark a finished write, odd ones a write in
+    // progress
+    struct Slot {
+        std::atomic<uint64_t> sequence{0};
+        Span span;
+    };
+
+    void _Write(const char *category, const std::string &name,
+                const uint64_t &start, const uint64_t &duration,
+                const TraceLane &lane, const uint32_t &thread);
+
+    std::unique_ptr<Slot[]> _slots;
+    size_t _mask;
+    std::atomic<uint64_t> _head{0};
+    std::atomic<bool> _enabled{false};
+    // Smallest host minus device time seen, used to move device timestamps
+    // onto the host clock
+    std::atomic<int64_t> _deviceOffset;
+};
+
+/**
+ * @brief Records a host span from construction to destruction
+ *
+ */
+class TraceScope {
+  public:
+    TraceScope(TraceRecorder &recorder, const char *category,
+               const std::string &name)
+        : _recorder(recorder.IsEnabled() ? &recorder : nullptr),
+          _category(category), _name(_recorder ? name : std::string()),
+          _start(_recorder ? TraceRecorder::Now() : 0) {}
+
+    ~TraceScope() {
+        if (_recorder) {
+            _recorder->RecordHost(_category, _name, _start,
+                                  TraceRecorder::Now());
+        }
+    }
+
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+  private:
+    TraceRecorder *_recorder;
+    const char *_category;
+    std::string _name;
+    uint64_t _start;
+};
+
+} // namespace peasyocl
+
+#endif
@@ -0,0 +1,143 @@
+// Copyright 2024 viktorlanner
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "TransferBatch.h"
+#include "Context.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace peasyocl {
+
+TransferBatch::TransferBatch(const cl::Context &context,
+                             const cl::CommandQueue &queue, Context *owner)
+    : _context(context), _queue(queue), _owner(owner) {}
+
+TransferBatch::~TransferBatch() { Wait(); }
+
+int TransferBatch::Add(const void *data, SharedBuffer buffer,
+                       const size_t &size, const size_t &offset) {
+    if (buffer == nullptr) {
+        printf("Error: Failed to add write to batch, buffer is null!\n");
+        return 1;
+    }
+    if (size == 0) {
+        return 0;
+    }
+
+    // The host staging memory may still be read by the last submit
+    Wait();
+
+    size_t staged = _host.size();
+    _host.resize(staged + size);
+    std::memcpy(_host.data() + staged, data, size);
+
+    // Writes continuing the previous one are merged into a single copy
+    if (!_pieces.empty()) {
+        Piece &last = _pieces.back();
+        if (last.buffer == buffer && last.offset + last.size == offset) {
+            last.size += size;
+            return 0;
+        }
+    }
+    _pieces.push_back({std::move(buffer), staged, offset, size});
+    return 0;
+}
+
+int TransferBatch::Submit(const bool blocking, cl::Event *event) {
+    if (_pieces.empty()) {
+        return 0;
+    }
+    Wait();
+
+    // Bring evicted buffers back before anything is enqueued
+    std::vector<BufferPin> pins;
+    pins.reserve(_pieces.size());
+    for (const Piece &piece : _pieces) {
+        pins.push_back(_Pin(piece.buffer));
+        if (!pins.back()) {
+            return 1;
+        }
+    }
+
+    cl_int err;
+    if (_capacity < _host.size()) {
+        // Keep the old staging buffer if the larger one can not be created
+        cl::Buffer staging(_context, CL_MEM_READ_ONLY, _host.size(), nullptr,
+                           &err);
+        if (err != CL_SUCCESS) {
+            printf("Error: Failed to create staging buffer of %zu bytes! %i\n",
+                   _host.size(), err);
+            return 1;
+        }
+        _staging = std::move(staging);
+        _capacity = _host.size();
+    }
+
+    err = _queue.enqueueWriteBuffer(_staging, CL_FALSE, 0, _host.size(),
+                                    _host.data());
+    if (err != CL_SUCCESS) {
+        printf("Error: Failed to write staging buffer! %i\n", err);
+        return 1;
+    }
+
+    for (size_t i = 0; i < _pieces.size(); i++) {
+        const Piece &piece = _pieces[i];
+        err = _queue.enqueueCopyBuffer(_staging, pins[i].Get(), piece.staged,
+                                       piece.offset, piece.size, nullptr,
+                                       &_done);
+        if (err != CL_SUCCESS) {
+            printf("Error: Failed to copy staged write to buffer! %i\n", err);
+            // The staging write may still be reading _host
+            _queue.finish();
+            return 1;
+        }
+    }
+    _pending = true;
+    _pieces.clear();
+
+    if (event) {
+        *event = _done;
+    }
+    if (blocking) {
+        Wait();
+    } else {
+        _queue.flush();
+    }
+    return 0;
+}
+
+void TransferBatch::Wait() {
+    if (!_pending) {
+        return;
+    }
+    _done.wait();
+    _pending = false;
+    _host.clear();
+}
+
+void TransferBatch::Clear() {
+    Wait();
+    _pieces.clear();
+    _host.clear();
+}
+
+BufferPin TransferBatch::_Pin(const SharedBuffer &buffer) {
+    if (_owner) {
+        return _owner->PinBuffer(buffer);
+    }
+    return BufferPin(nullptr, nullptr, buffer);
+}
+
+} // namespace peasyocl
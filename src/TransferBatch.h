@@ -0,0 +1,103 @@
+// Copyright 2024 viktorlanner
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef OCL_TRANSFER_BATCH_H
+#define OCL_TRANSFER_BATCH_H
+
+#include "MemoryManager.h"
+#include "Types.h"
+#include <vector>
+
+namespace peasyocl {
+
+class Context;
+
+/**
+ * @brief Gathers many small writes into one staging buffer. Submit uploads
+ * the staging buffer with a single write and scatters the pieces to their
+ * buffers with device side copies. Buffers of the owning context are
+ * restored if they were evicted and pinned while the copies are enqueued
+ *
+ */
+class TransferBatch {
+  public:
+    TransferBatch(const cl::Context &context, const cl::CommandQueue &queue,
+                  Context *owner = nullptr);
+    ~TransferBatch();
+    TransferBatch(const TransferBatch &) = delete;
+    TransferBatch &operator=(const TransferBatch &) = delete;
+
+    /**
+     * @brief Copy data into the batch. The data can be reused as soon as
+     * this returns
+     *
+     * @param data Data to write
+     * @param buffer Buffer object to write to
+     * @param size Size in bytes
+     * @param offset Offset in bytes into buffer
+     * @return int
+     */
+    int Add(const void *data, SharedBuffer buffer, const size_t &size,
+            const size_t &offset = 0);
+
+    template <typename T>
+    int Add(const T *data, SharedBuffer buffer, const size_t &size,
+            const size_t &offset = 0) {
+        return Add(static_cast<const void *>(data), std::move(buffer), size,
+                   offset);
+    }
+
+    /**
+     * @brief Upload all added writes and clear the batch
+     *
+     * @param blocking Wait for all writes to land in their buffers
+     * @param event Optional event that completes with the last write
+     * @return int
+     */
+    int Submit(const bool blocking = true, cl::Event *event = nullptr);
+
+    /**
+     * @brief Wait for the last submit to finish
+     *
+     */
+    void Wait();
+
+    void Clear();
+    bool Empty() const { return _pieces.empty(); }
+    size_t Size() const { return _host.size(); }
+
+  private:
+    struct Piece {
+        SharedBuffer buffer;
+        size_t staged;
+        size_t offset;
+        size_t size;
+    };
+
+    BufferPin _Pin(const SharedBuffer &buffer);
+
+    cl::Context _context;
+    cl::CommandQueue _queue;
+    Context *_owner;
+    cl::Buffer _staging;
+    size_t _capacity = 0;
+    std::vector<unsigned char> _host;
+    std::vector<Piece> _pieces;
+    cl::Event _done;
+    bool _pending = false;
+};
+
+} // namespace peasyocl
+
+#endif
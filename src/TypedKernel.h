@@ -0,0 +1,168 @@
+// Copyright 2024 viktorlanner
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef OCL_TYPED_KERNEL_H
+#define OCL_TYPED_KERNEL_H
+
+#include "Context.h"
+#include <array>
+#include <utility>
+
+namespace peasyocl {
+
+/**
+ * @brief Launches a kernel with all of its arguments in one call. The
+ * argument types are fixed at compile time, so a launch is at most one setArg
+ * per argument with a compile time size, and a single enqueue. Arguments
+ * that did not change since the last launch are not set again.
+ *
+ * Each host thread launches through its own kernel instance from the
+ * handle's pool, so one TypedKernel can be called from several threads at
+ * once. A SharedBuffer of the context is restored if it was evicted and
+ * pinned until the launch is enqueued. A cl::Buffer is bound as given, and
+ * mirrors are not synced. Launches do not wait, call Wait or
+ * Context::Finish before reading results
+ *
+ * @tparam Args Types of the kernel parameters in order
+ */
+template <typename... Args> class TypedKernel {
+  public:
+    explicit TypedKernel(KernelHandle *handle) : _handle(handle) {
+        if (!_handle || !_handle->built) {
+            printf("Error: TypedKernel needs a built kernel handle!\n");
+            _handle = nullptr;
+            return;
+        }
+        cl_uint count = 0;
+        _handle->kernel.getInfo(CL_KERNEL_NUM_ARGS, &count);
+        if (count != sizeof...(Args)) {
+            printf("Error: Kernel %s takes %u arguments, not %zu!\n",
+                   _handle->key.c_str(), count, sizeof...(Args));
+            _handle = nullptr;
+        }
+    }
+
+    bool IsValid() const { return _handle != nullptr; }
+
+    /**
+     * @brief Set the local work group size of later launches. Defaults to
+     * cl::NullRange, letting the implementation choose
+     *
+     * @param local
+     */
+    void SetLocal(const cl::NDRange &local) { _local = local; }
+
+    /**
+     * @brief Set all arguments and enqueue the kernel
+     *
+     * @param global Global work size
+     * @param args One value per kernel parameter
+     * @return int
+     */
+    int operator()(const cl::NDRange &global, const Args &...args) {
+        KernelInstance *instance = _handle ? _handle->ThreadKernel() : nullptr;
+        if (!instance) {
+            return 1;
+        }
+        std::array<BufferPin, sizeof...(Args)> pins;
+        if (_PinArguments(pins, std::index_sequence_for<Args...>{},
+                          args...) != 0) {
+            return 1;
+        }
+        cl_int err = _SetArguments(*instance, pins,
+                                   std::index_sequence_for<Args...>{},
+                                   args...);
+        if (err != CL_SUCCESS) {
+            printf("Error: Failed to set arguments of kernel %s! %i\n",
+                   _handle->key.c_str(), err);
+            return 1;
+        }
+        err = _handle->queue->enqueueNDRangeKernel(instance->kernel,
+                                                   cl::NullRange, global,
+                                                   _local, nullptr,
+                                                   &instance->event);
+        if (err != CL_SUCCESS) {
+            printf("Error: Failed to execute kernel %s! %i\n",
+                   _handle->key.c_str(), err);
+            return 1;
+        }
+        return 0;
+    }
+
+    /**
+     * @brief Wait for the last launch of the calling thread to complete
+     *
+     */
+    void Wait() {
+        cl::Event event = GetEvent();
+        if (event()) {
+            event.wait();
+        }
+    }
+    cl::Event GetEvent() {
+        KernelInstance *instance = _handle ? _handle->ThreadKernel() : nullptr;
+        return instance ? instance->event : cl::Event();
+    }
+
+  private:
+    using Pins = std::array<BufferPin, sizeof...(Args)>;
+
+    template <typename T> int _Pin(BufferPin &, const T &) { return 0; }
+    int _Pin(BufferPin &pin, const SharedBuffer &buffer) {
+        pin = _handle->owner->PinBuffer(buffer);
+        return pin ? 0 : 1;
+    }
+
+    template <size_t... Index>
+    int _PinArguments(Pins &pins, std::index_sequence<Index...>,
+                      const Args &...args) {
+        return (0 | ... | _Pin(pins[Index], args));
+    }
+
+    template <typename T>
+    static const T &_Value(BufferPin &, const T &value) {
+        return value;
+    }
+    static const cl::Buffer &_Value(BufferPin &pin, const SharedBuffer &) {
+        return pin.Get();
+    }
+
+    template <typename T>
+    static cl_int _Bind(KernelInstance &instance, const int index,
+                        const T &value) {
+        using Handler = cl::detail::KernelArgumentHandler<T>;
+        return instance.BindArgument(index, Handler::size(value),
+                                     Handler::ptr(value));
+    }
+
+    template <size_t... Index>
+    static cl_int _SetArguments(KernelInstance &instance, Pins &pins,
+                                std::index_sequence<Index...>,
+                                const Args &...args) {
+        cl_int err = CL_SUCCESS;
+        ((err = err == CL_SUCCESS
+                    ? _Bind(instance, Index, _Value(pins[Index], args))
+                    : err),
+         ...);
+        return err;
+    }
+
+    KernelHandle *_handle;
+    cl::NDRange _local = cl::NullRange;
+};
+
+} // namespace peasyocl
+
+#endif
@@ -0,0 +1,45 @@
+// Copyright 2024 viktorlanner
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef OCL_TYPES_H
+#define OCL_TYPES_H
+
+#define CL_HPP_TARGET_OPENCL_VERSION 120
+#define CL_HPP_MINIMUM_OPENCL_VERSION 120
+
+#include "opencl.hpp"
+#include <memory>
+
+namespace peasyocl {
+
+using SharedBuffer = std::shared_ptr<cl::Buffer>;
+using SharedImage = std::shared_ptr<cl::Image>;
+
+/**
+ * @brief A range of host memory and the offset in a buffer it maps to
+ *
+ * @tparam Pointer const void* for uploads, void* for readbacks
+ */
+template <typename Pointer> struct HostSpan {
+    Pointer data;
+    size_t size;
+    size_t offset;
+};
+
+using UploadSpan = HostSpan<const void *>;
+using ReadbackSpan = HostSpan<void *>;
+
+} // namespace peasyocl
+
+#endif